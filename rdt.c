@@ -0,0 +1,6119 @@
+#include "rdt.h"
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+
+// ------------------------------------------------------Command Line Options----------------------------------------------------//
+void parse_options(int argc, char *argv[], int first, struct Options *options)
+{
+
+	memset(options, 0, sizeof(*options));
+	options->fec_group = FEC_GROUP_SIZE;
+	options->max_retransmit = -1;
+	options->window = WINDOW_SIZE;
+	options->ack_frequency = ACK_FREQUENCY;
+
+	for (int i = first; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--pacing-rate") == 0 && i + 1 < argc)
+			options->pacing_rate = atol(argv[++i]);
+
+		else if (strcmp(argv[i], "--txtime") == 0)
+			options->use_txtime = 1;
+
+		else if (strcmp(argv[i], "--txtime-qdisc") == 0)
+			options->use_txtime = options->txtime_qdisc = 1;
+
+		else if (strcmp(argv[i], "--fec") == 0 && i + 1 < argc)
+			options->fec_parity = strcmp(argv[++i], "rs") == 0 ? FEC_RS_PARITY : 1;
+
+		else if (strcmp(argv[i], "--fec-parity") == 0 && i + 1 < argc)
+			options->fec_parity = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--fec-group") == 0 && i + 1 < argc)
+			options->fec_group = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--io-uring") == 0)
+			options->use_io_uring = 1;
+
+		else if (strcmp(argv[i], "--gso") == 0)
+			options->use_gso = 1;
+
+		else if (strcmp(argv[i], "--send-file") == 0 && i + 1 < argc)
+			options->send_file = argv[++i];
+
+		else if (strcmp(argv[i], "--receive-file") == 0 && i + 1 < argc)
+			options->receive_file = argv[++i];
+
+		else if (strcmp(argv[i], "--io-thread") == 0)
+			options->use_io_thread = 1;
+
+		else if (strcmp(argv[i], "--urgent-input") == 0 && i + 1 < argc)
+		{
+			options->urgent_input = argv[++i];
+			options->use_io_thread = 1;
+		}
+
+		else if (strcmp(argv[i], "--daemon") == 0 && i + 1 < argc)
+			options->daemon_path = argv[++i];
+
+		else if (strcmp(argv[i], "--coalesce") == 0 && i + 1 < argc)
+		{
+			options->coalesce = 1;
+			options->coalesce_delay = atol(argv[++i]);
+		}
+
+		else if (strcmp(argv[i], "--unordered") == 0)
+			options->unordered = 1;
+
+		else if (strcmp(argv[i], "--deadline") == 0 && i + 1 < argc)
+			options->deadline = atol(argv[++i]);
+
+		else if (strcmp(argv[i], "--max-retransmit") == 0 && i + 1 < argc)
+			options->max_retransmit = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc)
+			options->window = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--ack-frequency") == 0 && i + 1 < argc)
+			options->ack_frequency = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "--no-sack") == 0)
+			options->no_sack = 1;
+
+		else if (strcmp(argv[i], "--fan-out") == 0)
+			options->fan_out = 1;
+
+		else if (strcmp(argv[i], "--relay") == 0)
+			options->relay = options->fan_out = 1;
+
+		else if (strcmp(argv[i], "--path") == 0 && i + 1 < argc)
+		{
+			if (options->path_count == PATH_COUNT - 1 || inet_pton(AF_INET, argv[++i], &options->path_sources[options->path_count]) != 1)
+			{
+				fprintf(stderr, "%s\n", "A path needs an IPv4 address, and at most PATH_COUNT - 1 paths can be added!");
+				exit(-1);
+			}
+
+			options->path_count++;
+		}
+
+		else
+		{
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			exit(-1);
+		}
+	}
+
+	if (options->fec_parity < 0 || options->fec_parity > FEC_MAX_PARITY || options->fec_group < 1 || options->fec_group > WINDOW_SIZE)
+	{
+		fprintf(stderr, "%s\n", "FEC needs 1 to FEC_MAX_PARITY parity packets and 1 to WINDOW_SIZE chunks per group!");
+		exit(-1);
+	}
+
+	if (options->window < 1 || options->window > WINDOW_SIZE || options->ack_frequency < 1)
+	{
+		fprintf(stderr, "%s\n", "Window needs 1 to WINDOW_SIZE chunks and ACK frequency at least 1 chunk!");
+		exit(-1);
+	}
+
+	if (options->fan_out && (options->send_file || options->receive_file || options->path_count || options->fec_parity))
+	{
+		fprintf(stderr, "%s\n", "Fan-out sends typed lines only, it can't be used with files, paths or FEC!");
+		exit(-1);
+	}
+
+	return;
+}
+
+
+// ---------------------------------------------------------Transport-------------------------------------------------------------//
+void recycle_receive_buffer(struct Transport *transport, int buffer_id)
+{
+
+	struct io_uring_buf *buffer = &transport->buffer_ring->bufs[transport->buffer_ring_tail & (TRANSPORT_POOL_SIZE - 1)];
+
+	buffer->addr = (unsigned long) (transport->receive_buffers + buffer_id * transport->receive_size);
+	buffer->len = transport->receive_size;
+	buffer->bid = buffer_id;
+
+	transport->buffer_ring_tail++;
+	__atomic_store_n(&transport->buffer_ring->tail, transport->buffer_ring_tail, __ATOMIC_RELEASE);
+
+	return;
+}
+
+
+int setup_ring(struct Transport *transport)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Creates the ring with raw syscalls, maps its queues and registers the receive buffers of the packet pool as a provided
+	buffer ring. Returns -1 if the kernel doesn't support any of these.
+
+	*/
+
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+
+	transport->ring_fd = syscall(__NR_io_uring_setup, TRANSPORT_RING_ENTRIES, &params);
+
+	if (transport->ring_fd < 0)
+		return -1;
+
+	size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) && cq_size > sq_size)
+		sq_size = cq_size;
+
+	char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, transport->ring_fd, IORING_OFF_SQ_RING);
+	char *cq = sq;
+
+	if (!(params.features & IORING_FEAT_SINGLE_MMAP) && sq != MAP_FAILED)
+		cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, transport->ring_fd, IORING_OFF_CQ_RING);
+
+	transport->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						   transport->ring_fd, IORING_OFF_SQES);
+
+	if (sq == MAP_FAILED || cq == MAP_FAILED || transport->sqes == MAP_FAILED)
+	{
+		close(transport->ring_fd);
+		return -1;
+	}
+
+	transport->sq_head = (unsigned *) (sq + params.sq_off.head);
+	transport->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+	transport->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+	transport->sq_array = (unsigned *) (sq + params.sq_off.array);
+	transport->cq_head = (unsigned *) (cq + params.cq_off.head);
+	transport->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+	transport->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+	transport->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+	// Provided buffers for the multishot RECVMSG
+	transport->buffer_ring = mmap(NULL, TRANSPORT_POOL_SIZE * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+								  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+	transport->receive_buffers = malloc(TRANSPORT_POOL_SIZE * transport->receive_size);
+
+	struct io_uring_buf_reg registration;
+
+	memset(&registration, 0, sizeof(registration));
+	registration.ring_addr = (unsigned long) transport->buffer_ring;
+	registration.ring_entries = TRANSPORT_POOL_SIZE;
+	registration.bgid = TRANSPORT_BUFFER_GROUP;
+
+	if (transport->buffer_ring == MAP_FAILED || 
+		syscall(__NR_io_uring_register, transport->ring_fd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+	{
+		close(transport->ring_fd);
+		return -1;
+	}
+
+	for (int i = 0; i < TRANSPORT_POOL_SIZE; i++)
+		recycle_receive_buffer(transport, i);
+
+	transport->receive_header.msg_namelen = sizeof(struct sockaddr_in);
+	transport->receive_header.msg_controllen = transport->use_gro ? CMSG_SPACE(sizeof(int)) : 0;
+
+	// Send buffers
+	transport->send_slots = calloc(TRANSPORT_POOL_SIZE, sizeof(struct Transport_Slot));
+
+	for (int i = 0; i < TRANSPORT_POOL_SIZE; i++)
+		transport->free_slots[i] = i;
+
+	transport->free_count = TRANSPORT_POOL_SIZE;
+
+	return 0;
+}
+
+
+void initialize_transport(struct Transport *transport, int sockfd, struct Options *options)
+{
+
+	memset(transport, 0, sizeof(*transport));
+	transport->sockfd = sockfd;
+
+	transport->poll_fd[0].fd = sockfd;
+	transport->poll_fd[0].events = POLLIN;
+
+	transport->input_fd = STDIN_FILENO;
+	transport->poll_fd[1].fd = STDIN_FILENO;
+	transport->poll_fd[1].events = POLLIN;
+
+	transport->receive_size = TRANSPORT_BUFFER_SIZE;
+
+	if (options->use_gso)
+	{
+		int segment_size = 0, enable = 1;
+
+		// Only checks that the kernel knows UDP_SEGMENT, the segment size is given with each sendmsg.
+		if (setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &segment_size, sizeof(segment_size)) == 0)
+			transport->use_gso = 1;
+		else
+			fprintf(stderr, "%s\n", "UDP_SEGMENT is not available, sending datagrams one by one.");
+
+		if (setsockopt(sockfd, SOL_UDP, UDP_GRO, &enable, sizeof(enable)) == 0)
+		{
+			transport->use_gro = 1;
+			transport->receive_size = TRANSPORT_RECEIVE_SIZE;
+		}
+		else
+			fprintf(stderr, "%s\n", "UDP_GRO is not available, receiving datagrams one by one.");
+	}
+
+	if (options->use_io_uring)
+	{
+		if (setup_ring(transport) == 0)
+			transport->use_uring = 1;
+		else
+			fprintf(stderr, "%s\n", "io_uring is not available, using sendmsg/recvmsg.");
+	}
+
+	if (!transport->use_uring)
+		transport->receive_buffer = malloc(transport->receive_size);
+
+	return;
+}
+
+
+int enter_ring(struct Transport *transport, unsigned min_complete, long time_out)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Submits the pending requests and waits for `min_complete` completions, at most `time_out` microseconds if it isn't negative.
+
+	*/
+
+	struct __kernel_timespec wait_time;
+	struct io_uring_getevents_arg argument;
+	unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+	memset(&argument, 0, sizeof(argument));
+
+	if (time_out >= 0)
+	{
+		wait_time.tv_sec = time_out / 1000000;
+		wait_time.tv_nsec = (time_out % 1000000) * 1000;
+		argument.ts = (unsigned long) &wait_time;
+		flags |= IORING_ENTER_EXT_ARG;
+	}
+
+	int submitted = syscall(__NR_io_uring_enter, transport->ring_fd, transport->pending_submissions, min_complete, flags,
+							time_out >= 0 ? (void *) &argument : NULL, sizeof(argument));
+
+	if (submitted > 0)
+		transport->pending_submissions -= submitted;
+
+	return submitted;
+}
+
+
+struct io_uring_sqe* get_submission(struct Transport *transport)
+{
+
+	unsigned tail = *transport->sq_tail;
+
+	if (tail - __atomic_load_n(transport->sq_head, __ATOMIC_ACQUIRE) > *transport->sq_mask)
+	{
+		enter_ring(transport, 0, -1);
+
+		if (tail - __atomic_load_n(transport->sq_head, __ATOMIC_ACQUIRE) > *transport->sq_mask)
+			return NULL;
+	}
+
+	unsigned index = tail & *transport->sq_mask;
+	struct io_uring_sqe *submission = &transport->sqes[index];
+
+	memset(submission, 0, sizeof(*submission));
+	transport->sq_array[index] = index;
+
+	return submission;
+}
+
+
+void queue_submission(struct Transport *transport)
+{
+
+	__atomic_store_n(transport->sq_tail, *transport->sq_tail + 1, __ATOMIC_RELEASE);
+	transport->pending_submissions++;
+
+	return;
+}
+
+
+void arm_requests(struct Transport *transport)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- The multishot RECVMSG stops when it runs out of provided buffers or fails, and POLL_ADD fires once, so both are queued
+	again here when needed.
+
+	*/
+
+	struct io_uring_sqe *submission;
+
+	if (!transport->receive_armed && (submission = get_submission(transport)))
+	{
+		submission->opcode = IORING_OP_RECVMSG;
+		submission->fd = transport->sockfd;
+		submission->addr = (unsigned long) &transport->receive_header;
+		submission->len = 1;
+		submission->ioprio = IORING_RECV_MULTISHOT;
+		submission->flags = IOSQE_BUFFER_SELECT;
+		submission->buf_group = TRANSPORT_BUFFER_GROUP;
+		submission->user_data = (__u64) TRANSPORT_RECEIVE << 32;
+
+		queue_submission(transport);
+		transport->receive_armed = 1;
+	}
+
+	if (!transport->stdin_armed && !transport->stdin_ready && !transport->stdin_closed && !transport->stdin_paused &&
+		(submission = get_submission(transport)))
+	{
+		submission->opcode = IORING_OP_POLL_ADD;
+		submission->fd = transport->input_fd;
+		submission->poll32_events = POLLIN;
+		submission->user_data = (__u64) TRANSPORT_STDIN << 32;
+
+		queue_submission(transport);
+		transport->stdin_armed = 1;
+	}
+
+	return;
+}
+
+
+void reap_completions(struct Transport *transport)
+{
+
+	unsigned head = *transport->cq_head;
+	unsigned tail = __atomic_load_n(transport->cq_tail, __ATOMIC_ACQUIRE);
+
+	for (; head != tail; head++)
+	{
+		struct io_uring_cqe *completion = &transport->cqes[head & *transport->cq_mask];
+		int kind = completion->user_data >> 32;
+		int index = completion->user_data & 0xffffffff;
+
+		if (kind == TRANSPORT_SEND)
+			transport->free_slots[transport->free_count++] = index;
+
+		else if (kind == TRANSPORT_RECEIVE)
+		{
+			if (completion->res > 0 && (completion->flags & IORING_CQE_F_BUFFER))
+			{
+				int tail_index = (transport->ready_head + transport->ready_count) % TRANSPORT_POOL_SIZE;
+
+				transport->ready_buffers[tail_index] = completion->flags >> IORING_CQE_BUFFER_SHIFT;
+				transport->ready_lengths[tail_index] = completion->res;
+				transport->ready_count++;
+			}
+
+			if (!(completion->flags & IORING_CQE_F_MORE))
+				transport->receive_armed = 0;
+		}
+
+		else if (kind == TRANSPORT_STDIN)
+		{
+			transport->stdin_armed = 0;
+
+			if (completion->res > 0 && (completion->res & (POLLIN | POLLHUP)))
+				transport->stdin_ready = 1;
+			else if (completion->res > 0)
+				transport->stdin_closed = 1;
+		}
+	}
+
+	__atomic_store_n(transport->cq_head, head, __ATOMIC_RELEASE);
+
+	return;
+}
+
+
+void tune_socket_buffers(struct Transport *transport, long bytes)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Grows SO_SNDBUF and SO_RCVBUF to hold `bytes`, it never shrinks them below what the socket already has. The kernel caps the
+	request at net.core.wmem_max / rmem_max unless the FORCE variants are allowed, and that is reported once per buffer: datagrams
+	dropped by a full socket buffer look exactly like loss on the network.
+
+	*/
+
+	if (bytes <= transport->socket_buffer)
+		return;
+
+	transport->socket_buffer = bytes;
+
+	int options[2][2] = { { SO_SNDBUF, SO_SNDBUFFORCE }, { SO_RCVBUF, SO_RCVBUFFORCE } };
+	const char *names[2] = { "SO_SNDBUF (net.core.wmem_max)", "SO_RCVBUF (net.core.rmem_max)" };
+	int size = bytes > INT_MAX / 2 ? INT_MAX / 2 : bytes;
+
+	for (int i = 0; i < 2; i++)
+	{
+		int current = 0;
+		socklen_t len = sizeof(current);
+
+		// The kernel reports twice the requested size, the other half is for its bookkeeping.
+		if (getsockopt(transport->sockfd, SOL_SOCKET, options[i][0], &current, &len) == 0 && current >= 2 * size)
+			continue;
+
+		if (setsockopt(transport->sockfd, SOL_SOCKET, options[i][1], &size, sizeof(size)) != 0)
+			setsockopt(transport->sockfd, SOL_SOCKET, options[i][0], &size, sizeof(size));
+
+		len = sizeof(current);
+
+		if (getsockopt(transport->sockfd, SOL_SOCKET, options[i][0], &current, &len) == 0 && current < 2 * size &&
+			!(transport->buffer_capped & (1 << i)))
+		{
+			fprintf(stderr, "%s is capped at %d bytes, %d were requested.\n", names[i], current / 2, size);
+			transport->buffer_capped |= 1 << i;
+		}
+	}
+
+	return;
+}
+
+
+ssize_t transmit(struct Transport *transport, void *data, size_t size, struct sockaddr_in *address, long departure_time, int segment_size)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Hands one buffer to the kernel. `departure_time` is given as an SCM_TXTIME control message and `segment_size` as a UDP_SEGMENT
+	control message if they aren't 0, and the source address of the transport as an IP_PKTINFO one. With io_uring the buffer is only queued, it leaves when TRANSPORT_BATCH submissions are
+	pending or the main loop waits for events.
+
+	*/
+
+	struct iovec iov = { .iov_base = data, .iov_len = size };
+	struct msghdr header;
+	struct sockaddr_in *name = address;
+	char local_control[TRANSPORT_CONTROL_SIZE];
+	char *control = local_control;
+	int slot_index = 0;
+
+	if (transport->use_uring)
+	{
+		// Every slot is in flight, wait until the kernel is done with one of them.
+		while (transport->free_count == 0)
+		{
+			if (enter_ring(transport, 1, -1) < 0)
+				return -1;
+
+			reap_completions(transport);
+		}
+
+		if (size > sizeof(transport->send_slots[0].data))
+			return -1;
+
+		slot_index = transport->free_slots[--transport->free_count];
+
+		struct Transport_Slot *slot = &transport->send_slots[slot_index];
+
+		memcpy(slot->data, data, size);
+		slot->address = *address;
+		slot->iov.iov_base = slot->data;
+		slot->iov.iov_len = size;
+
+		name = &slot->address;
+		control = slot->control;
+	}
+
+	memset(&header, 0, sizeof(header));
+
+	header.msg_name = name;
+	header.msg_namelen = sizeof(*name);
+	header.msg_iovlen = 1;
+
+	int control_length = (departure_time ? CMSG_SPACE(sizeof(__u64)) : segment_size ? CMSG_SPACE(sizeof(__u16)) : 0) +
+						 (transport->source.s_addr ? CMSG_SPACE(sizeof(struct in_pktinfo)) : 0);
+
+	if (control_length)
+	{
+		memset(control, 0, TRANSPORT_CONTROL_SIZE);
+		header.msg_control = control;
+		header.msg_controllen = control_length;
+
+		struct cmsghdr *control_message = CMSG_FIRSTHDR(&header);
+
+		if (departure_time)
+		{
+			control_message->cmsg_level = SOL_SOCKET;
+			control_message->cmsg_type = SCM_TXTIME;
+			control_message->cmsg_len = CMSG_LEN(sizeof(__u64));
+			*((__u64 *) CMSG_DATA(control_message)) = departure_time;
+			control_message = CMSG_NXTHDR(&header, control_message);
+		}
+		else if (segment_size)
+		{
+			control_message->cmsg_level = SOL_UDP;
+			control_message->cmsg_type = UDP_SEGMENT;
+			control_message->cmsg_len = CMSG_LEN(sizeof(__u16));
+			*((__u16 *) CMSG_DATA(control_message)) = segment_size;
+			control_message = CMSG_NXTHDR(&header, control_message);
+		}
+
+		if (transport->source.s_addr)
+		{
+			struct in_pktinfo *info = (struct in_pktinfo *) CMSG_DATA(control_message);
+
+			control_message->cmsg_level = IPPROTO_IP;
+			control_message->cmsg_type = IP_PKTINFO;
+			control_message->cmsg_len = CMSG_LEN(sizeof(struct in_pktinfo));
+			info->ipi_spec_dst = transport->source;
+		}
+	}
+
+	if (!transport->use_uring)
+	{
+		header.msg_iov = &iov;
+
+		return sendmsg(transport->sockfd, &header, MSG_CONFIRM);
+	}
+
+	struct Transport_Slot *slot = &transport->send_slots[slot_index];
+	struct io_uring_sqe *submission = get_submission(transport);
+
+	if (submission == NULL)
+	{
+		transport->free_slots[transport->free_count++] = slot_index;
+		return -1;
+	}
+
+	header.msg_iov = &slot->iov;
+	slot->header = header;
+
+	submission->opcode = IORING_OP_SENDMSG;
+	submission->fd = transport->sockfd;
+	submission->addr = (unsigned long) &slot->header;
+	submission->len = 1;
+	submission->msg_flags = MSG_CONFIRM;
+	submission->user_data = (__u64) TRANSPORT_SEND << 32 | slot_index;
+
+	queue_submission(transport);
+
+	if (transport->pending_submissions >= TRANSPORT_BATCH)
+		enter_ring(transport, 0, -1);
+
+	return size;
+}
+
+
+void flush_segments(struct Transport *transport)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends the datagrams collected for GSO with one sendmsg. The kernel splits the buffer into gso_size datagrams. If the
+	device can't do it, GSO is turned off and the datagrams are sent one by one.
+
+	*/
+
+	if (transport->gso_count == 0)
+		return;
+
+	int count = transport->gso_count;
+	size_t length = count * transport->gso_size;
+
+	transport->gso_count = 0;
+
+	if (count > 1 && transmit(transport, transport->gso_buffer, length, &transport->gso_address, 0, transport->gso_size) >= 0)
+		return;
+
+	if (count > 1)
+	{
+		fprintf(stderr, "%s\n", "UDP_SEGMENT failed, sending datagrams one by one.");
+		transport->use_gso = 0;
+	}
+
+	for (int i = 0; i < count; i++)
+		transmit(transport, transport->gso_buffer + i * transport->gso_size, transport->gso_size, &transport->gso_address, 0, 0);
+
+	return;
+}
+
+
+ssize_t transport_send(struct Transport *transport, void *data, size_t size, struct sockaddr_in *address, long departure_time)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends one datagram. With GSO, datagrams of the same size to the same address are collected into one buffer of at most
+	TRANSPORT_GSO_SEGMENTS segments, which is flushed when the main loop is about to wait. Kernel paced datagrams carry their own
+	departure time, so they are sent on their own.
+
+	*/
+
+	if (!transport->use_gso || departure_time || size > sizeof(transport->gso_buffer))
+	{
+		flush_segments(transport);
+
+		return transmit(transport, data, size, address, departure_time, 0);
+	}
+
+	if (transport->gso_count && (transport->gso_size != size || transport->gso_count == TRANSPORT_GSO_SEGMENTS ||
+		(transport->gso_count + 1) * size > sizeof(transport->gso_buffer) ||
+		memcmp(&transport->gso_address, address, sizeof(*address)) != 0))
+		flush_segments(transport);
+
+	if (transport->gso_count == 0)
+	{
+		transport->gso_size = size;
+		transport->gso_address = *address;
+	}
+
+	memcpy(transport->gso_buffer + transport->gso_count * size, data, size);
+	transport->gso_count++;
+
+	return size;
+}
+
+
+void select_source(struct Transport *transport, struct in_addr source)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Datagrams sent from now on leave from `source`. Datagrams collected for GSO share one source, so they are sent first.
+
+	*/
+
+	if (transport->source.s_addr == source.s_addr)
+		return;
+
+	flush_segments(transport);
+	transport->source = source;
+
+	return;
+}
+
+
+void pause_stdin(struct Transport *transport, int paused)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Stops or restarts polling stdin. A negative descriptor is ignored by ppoll, and the POLL_ADD isn't queued again while paused.
+
+	*/
+
+	transport->stdin_paused = paused;
+	transport->poll_fd[1].fd = paused ? -1 : transport->input_fd;
+
+	return;
+}
+
+
+int transport_wait(struct Transport *transport, long time_out, int *socket_ready, int *stdin_ready)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Waits at most `time_out` microseconds until a datagram or a line from stdin is available. With io_uring, queued sends are
+	submitted and completions are collected by the same io_uring_enter. When the main loop has more to send right away (0
+	timeout), fewer than TRANSPORT_BATCH queued sends don't cost a syscall, and GSO keeps collecting datagrams.
+
+	*/
+
+	int num_events;
+	int buffered = transport->segment_left > 0;
+
+	if (time_out > 0)
+		flush_segments(transport);
+
+	// Segments of a GRO buffer are still waiting to be read.
+	if (buffered)
+		time_out = 0;
+
+	if (!transport->use_uring)
+	{
+		struct timespec poll_time;
+		poll_time.tv_sec = time_out / 1000000;
+		poll_time.tv_nsec = (time_out % 1000000) * 1000;
+
+		num_events = ppoll(transport->poll_fd, 2, &poll_time, NULL);
+
+		*socket_ready = (transport->poll_fd[0].revents & POLLIN) || buffered;
+		*stdin_ready = transport->poll_fd[1].revents & (POLLIN | POLLHUP);
+
+		return num_events;
+	}
+
+	arm_requests(transport);
+	reap_completions(transport);
+
+	if (transport->ready_count == 0 && !transport->stdin_ready && time_out > 0)
+	{
+		enter_ring(transport, 1, time_out);
+		reap_completions(transport);
+	}
+	else if (transport->pending_submissions && (time_out > 0 || transport->pending_submissions >= TRANSPORT_BATCH))
+		enter_ring(transport, 0, -1);
+
+	// A request that ended while waiting is queued again on the next call.
+	*socket_ready = transport->ready_count > 0 || buffered;
+	*stdin_ready = transport->stdin_ready;
+	transport->stdin_ready = 0;
+
+	return (*socket_ready != 0) + (*stdin_ready != 0);
+}
+
+
+int gro_segment_size(struct msghdr *header)
+{
+
+	for (struct cmsghdr *control_message = CMSG_FIRSTHDR(header); control_message; control_message = CMSG_NXTHDR(header, control_message))
+		if (control_message->cmsg_level == SOL_UDP && control_message->cmsg_type == UDP_GRO)
+			return *((int *) CMSG_DATA(control_message));
+
+	return 0;
+}
+
+
+ssize_t transport_receive(struct Transport *transport, void *data, size_t size, struct sockaddr_in *address)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Returns the next received datagram. With GRO, the kernel may coalesce several datagrams from the same sender into one
+	buffer, they are returned one segment at a time before the next buffer is read.
+
+	*/
+
+	if (transport->segment_left == 0)
+	{
+		// `header` points at the control data until gro_segment_size has read it below.
+		struct msghdr header;
+		char control[CMSG_SPACE(sizeof(int))];
+		ssize_t n;
+
+		memset(&header, 0, sizeof(header));
+
+		if (!transport->use_uring)
+		{
+			struct iovec iov = { .iov_base = transport->receive_buffer, .iov_len = transport->receive_size };
+
+			header.msg_name = &transport->segment_address;
+			header.msg_namelen = sizeof(transport->segment_address);
+			header.msg_iov = &iov;
+			header.msg_iovlen = 1;
+			header.msg_control = control;
+			header.msg_controllen = sizeof(control);
+
+			n = recvmsg(transport->sockfd, &header, MSG_DONTWAIT);
+
+			if (n < 0)
+				return -1;
+
+			transport->segment_data = transport->receive_buffer;
+			transport->segment_buffer_id = -1;
+		}
+		else
+		{
+			if (transport->ready_count == 0)
+				return -1;
+
+			int buffer_id = transport->ready_buffers[transport->ready_head];
+			char *buffer = transport->receive_buffers + buffer_id * transport->receive_size;
+
+			transport->ready_head = (transport->ready_head + 1) % TRANSPORT_POOL_SIZE;
+			transport->ready_count--;
+
+			// Buffer layout of a multishot RECVMSG: header, address, control data, payload.
+			struct io_uring_recvmsg_out *received = (struct io_uring_recvmsg_out *) buffer;
+			char *name = buffer + sizeof(*received);
+			char *received_control = name + transport->receive_header.msg_namelen;
+
+			if (received->namelen >= sizeof(transport->segment_address))
+				memcpy(&transport->segment_address, name, sizeof(transport->segment_address));
+
+			header.msg_control = received_control;
+			header.msg_controllen = received->controllen;
+			transport->segment_data = received_control + transport->receive_header.msg_controllen;
+			transport->segment_buffer_id = buffer_id;
+
+			// A truncated datagram reports its full length.
+			n = received->payloadlen;
+
+			if (n > transport->receive_size - (transport->segment_data - buffer))
+				n = transport->receive_size - (transport->segment_data - buffer);
+		}
+
+		int segment_size = transport->use_gro ? gro_segment_size(&header) : 0;
+
+		transport->segment_left = n;
+		transport->segment_size = segment_size > 0 ? segment_size : n;
+
+		// Empty datagram
+		if (n == 0)
+		{
+			if (transport->segment_buffer_id >= 0)
+				recycle_receive_buffer(transport, transport->segment_buffer_id);
+
+			*address = transport->segment_address;
+			return 0;
+		}
+	}
+
+	ssize_t n = transport->segment_left < transport->segment_size ? transport->segment_left : transport->segment_size;
+
+	memcpy(data, transport->segment_data, (size_t) n < size ? (size_t) n : size);
+	*address = transport->segment_address;
+
+	transport->segment_data += n;
+	transport->segment_left -= n;
+
+	if (transport->segment_left == 0 && transport->segment_buffer_id >= 0)
+		recycle_receive_buffer(transport, transport->segment_buffer_id);
+
+	return n;
+}
+
+
+void close_transport(struct Transport *transport)
+{
+
+	flush_segments(transport);
+	free(transport->receive_buffer);
+
+	if (!transport->use_uring)
+		return;
+
+	// The kernel may still read the send slots until their completions arrive.
+	while (transport->free_count < TRANSPORT_POOL_SIZE && enter_ring(transport, 1, TIME_OUT) >= 0)
+		reap_completions(transport);
+
+	close(transport->ring_fd);
+	free(transport->send_slots);
+	free(transport->receive_buffers);
+
+	return;
+}
+
+
+// ---------------------------------------------Single Producer Single Consumer Ring----------------------------------------------//
+void initialize_spsc_ring(struct Spsc_Ring *ring, int consumer_event, int producer_event)
+{
+
+	ring->head = 0;
+	ring->tail = 0;
+	ring->consumer_event = consumer_event;
+	ring->producer_event = producer_event;
+	ring->closed = 0;
+
+	return;
+}
+
+
+void signal_event(int event)
+{
+
+	unsigned long one = 1;
+
+	if (event >= 0 && write(event, &one, sizeof(one)) < 0)
+		return;
+
+	return;
+}
+
+
+void clear_event(int event)
+{
+
+	unsigned long count;
+
+	if (read(event, &count, sizeof(count)) < 0)
+		return;
+
+	return;
+}
+
+
+struct Spsc_Slot* spsc_reserve(struct Spsc_Ring *ring)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Producer side. The slot is filled in place and becomes visible to the consumer with spsc_commit.
+
+	Returns:
+	--------
+
+	- The next free slot, NULL if the ring is full.
+
+	*/
+
+	unsigned tail = ring->tail;
+
+	if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == SPSC_SLOTS)
+		return NULL;
+
+	return &ring->slots[tail % SPSC_SLOTS];
+}
+
+
+void spsc_commit(struct Spsc_Ring *ring)
+{
+
+	unsigned tail = ring->tail;
+
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+	// The consumer either sees the new tail or has already emptied the ring and gets woken up.
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+		signal_event(ring->consumer_event);
+
+	return;
+}
+
+
+struct Spsc_Slot* spsc_peek(struct Spsc_Ring *ring)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Consumer side. The slot stays valid until spsc_release.
+
+	Returns:
+	--------
+
+	- The oldest slot, NULL if the ring is empty.
+
+	*/
+
+	unsigned head = ring->head;
+
+	if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == head)
+		return NULL;
+
+	return &ring->slots[head % SPSC_SLOTS];
+}
+
+
+void spsc_release(struct Spsc_Ring *ring)
+{
+
+	unsigned head = ring->head;
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - head == SPSC_SLOTS)
+		signal_event(ring->producer_event);
+
+	return;
+}
+
+
+unsigned spsc_count(struct Spsc_Ring *ring)
+{
+
+	return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+
+// -------------------------------------------------Reliable Data Transfer--------------------------------------------------------//
+void initialize_window(struct Window *window, int window_size)
+{
+	
+	memset(window, 0, sizeof(*window));
+	window->window_size = window_size;
+	window->sequence_number = 0;
+	window->pass = 0;
+	window->buffer_available = window_size;
+	window->cache_index = 0;
+
+
+	return;
+}
+
+
+long time_in_microseconds(struct timeval *time)
+{
+	return time->tv_sec * 1000000L + time->tv_usec;
+}
+
+
+long current_time_in_microseconds()
+{
+	struct timeval current_time;
+
+	gettimeofday(&current_time, NULL);
+
+	return time_in_microseconds(&current_time);
+}
+
+
+void update_rtt_estimator(struct RTT_Estimator *rtt, long sample)
+{
+
+	if (sample < 0)
+		return;
+
+	if (!rtt->has_sample)
+	{
+		rtt->srtt = sample;
+		rtt->rttvar = sample / 2;
+		rtt->has_sample = 1;
+		return;
+	}
+
+	long delta = sample - rtt->srtt;
+
+	if (delta < 0)
+		delta = -delta;
+
+	rtt->rttvar = (3 * rtt->rttvar + delta) / 4;
+	rtt->srtt = (7 * rtt->srtt + sample) / 8;
+
+	return;
+}
+
+
+long probe_time_out(struct RTT_Estimator *rtt)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Tail loss probe fires after 2 * SRTT without any ACK. Before the first sample, half of the retransmission timeout is used so that
+	the probe still comes before the Timeout block.
+
+	*/
+
+	long probe_time = rtt->has_sample ? 2 * rtt->srtt : TIME_OUT / 2;
+
+	if (probe_time < PROBE_TIME_OUT_MIN)
+		probe_time = PROBE_TIME_OUT_MIN;
+
+	return probe_time;
+}
+
+
+long monotonic_time_in_nanoseconds()
+{
+	struct timespec current_time;
+
+	clock_gettime(CLOCK_MONOTONIC, &current_time);
+
+	return current_time.tv_sec * 1000000000L + current_time.tv_nsec;
+}
+
+
+void initialize_pacer(struct Pacer *pacer, int sockfd, struct Options *options)
+{
+
+	memset(pacer, 0, sizeof(*pacer));
+	pacer->explicit_rate = options->pacing_rate;
+	pacer->rate = options->pacing_rate;
+	pacer->tokens = PACING_BURST * DATAGRAM_HEADER_SIZE;
+	pacer->last_refill = monotonic_time_in_nanoseconds();
+
+	if (options->use_txtime)
+	{
+		struct sock_txtime txtime_config;
+
+		txtime_config.clockid = CLOCK_MONOTONIC;
+		txtime_config.flags = 0;
+
+		if (setsockopt(sockfd, SOL_SOCKET, SO_TXTIME, &txtime_config, sizeof(txtime_config)) == 0)
+		{
+			pacer->use_txtime = 1;
+			pacer->qdisc_paces = options->txtime_qdisc;
+		}
+		else
+			fprintf(stderr, "%s\n", "SO_TXTIME is not available, pacing in userspace.");
+	}
+
+	return;
+}
+
+
+void update_pacing_rate(struct Pacer *pacer, struct RTT_Estimator *rtt, int window_size)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Without an explicit rate, one window of packets is spread over one SRTT, with PACING_GAIN_PERCENT of headroom so that pacing
+	itself doesn't become the bottleneck.
+
+	*/
+
+	if (pacer->explicit_rate || !rtt->has_sample || rtt->srtt <= 0)
+		return;
+
+	pacer->rate = (long) window_size * DATAGRAM_HEADER_SIZE * 1000000L / rtt->srtt * PACING_GAIN_PERCENT / 100;
+
+	return;
+}
+
+
+void refill_pacer(struct Pacer *pacer, long now)
+{
+
+	if (pacer->rate == 0)
+		return;
+
+	pacer->tokens += (double) pacer->rate * (now - pacer->last_refill) / 1000000000.0;
+	pacer->last_refill = now;
+
+	if (pacer->tokens > PACING_BURST * DATAGRAM_HEADER_SIZE)
+		pacer->tokens = PACING_BURST * DATAGRAM_HEADER_SIZE;
+
+	return;
+}
+
+
+long pacer_delay(struct Pacer *pacer, int bytes)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Returns how many nanoseconds the main loop must wait before a new packet of `bytes` can be sent. With kernel pacing, the
+	packet can be handed over right away unless its departure time would be more than PACING_HORIZON in the future. A successful
+	SO_TXTIME alone doesn't mean that the qdisc holds packets, so that needs `--txtime-qdisc` (see struct Pacer).
+
+	*/
+
+	if (pacer->rate == 0)
+		return 0;
+
+	refill_pacer(pacer, monotonic_time_in_nanoseconds());
+
+	long delay = 0;
+
+	if (pacer->tokens < bytes)
+		delay = (long) ((bytes - pacer->tokens) * 1000000000.0 / pacer->rate);
+
+	if (pacer->qdisc_paces)
+		return delay > PACING_HORIZON ? delay - PACING_HORIZON : 0;
+
+	return delay;
+}
+
+
+unsigned long fnv1a(unsigned long digest, const char *data, long length)
+{
+
+	for (long i = 0; i < length; i++)
+	{
+		digest ^= (unsigned char) data[i];
+		digest *= FNV_PRIME;
+	}
+
+	return digest;
+}
+
+
+size_t datagram_size(struct UDP_Datagram *packet)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Number of bytes of `packet` that go on the wire. Only HELLO and the resume handshake carry the `control` fields, every other
+	packet (the chunks above all) ends before them.
+
+	*/
+
+	if (packet->type == HELLO_PACKET || packet->type == RESUME_REQUEST || packet->type == RESUME_REPLY)
+		return sizeof(*packet);
+
+	return DATAGRAM_HEADER_SIZE;
+}
+
+
+int calculate_checksum(struct UDP_Datagram *packet)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- FNV-1a over the bytes of the datagram that are sent (see datagram_size) except the checksum field itself: the payload, the
+	acknowledgement, the file offset, the HELLO fields and everything else. A corrupted field must not be trusted, e.g. a wrong
+	file offset would write the chunk into the wrong place of the file. The packet has to be complete when this is called, see
+	send_datagram.
+
+	*/
+
+	const char *bytes = (const char *) packet;
+	long after = offsetof(struct UDP_Datagram, checksum) + sizeof(packet->checksum);
+	unsigned long digest = fnv1a(FNV_OFFSET_BASIS, bytes, offsetof(struct UDP_Datagram, checksum));
+
+	digest = fnv1a(digest, bytes + after, datagram_size(packet) - after);
+
+	return (int) (digest ^ digest >> 32);
+}
+
+
+ssize_t send_datagram(struct Transport *transport, struct Pacer *pacer, struct UDP_Datagram *packet, struct sockaddr_in *address)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends a data packet and takes its tokens from the pacer. Retransmissions don't wait for tokens, they only delay the next
+	new packet. With SO_TXTIME, the departure time is given to the kernel as a control message. The checksum is computed here,
+	after the acknowledgement has been piggybacked.
+
+	*/
+
+	long departure_time = 0;
+	size_t size = datagram_size(packet);
+
+	packet->checksum = calculate_checksum(packet);
+
+	if (pacer->rate)
+	{
+		long now = monotonic_time_in_nanoseconds();
+
+		refill_pacer(pacer, now);
+
+		departure_time = now;
+
+		if (pacer->tokens < size)
+			departure_time += (long) ((size - pacer->tokens) * 1000000000.0 / pacer->rate);
+
+		pacer->tokens -= size;
+	}
+
+	return transport_send(transport, packet, size, address, pacer->use_txtime ? departure_time : 0);
+}
+
+
+int saved_flags[2] = { -1, -1 }; // File status flags of stdin and stdout before set_non_blocking changed them, -1 if unchanged.
+
+
+void restore_flags(void)
+{
+
+	/*
+	
+	Function Description:
+	---------------------
+	
+	- Puts back the file status flags that set_non_blocking changed on stdin and stdout. A pipe or terminal is shared with the parent
+	shell, so leaving O_NONBLOCK on it breaks whatever reads or writes it next. Runs at exit and on a fatal signal.
+	
+	*/
+
+	int fd;
+
+	for (fd = STDIN_FILENO; fd <= STDOUT_FILENO; fd++)
+		if (saved_flags[fd] != -1)
+			fcntl(fd, F_SETFL, saved_flags[fd]);
+
+	return;
+}
+
+
+void restore_flags_and_raise(int signal_number)
+{
+
+	restore_flags();
+	signal(signal_number, SIG_DFL);
+	raise(signal_number);
+
+	return;
+}
+
+
+void set_non_blocking(int fd)
+{
+
+	/*
+	
+	Function Description:
+	---------------------
+	
+	- Sets O_NONBLOCK on fd. For stdin and stdout the old flags are saved first and restored by restore_flags when the program ends,
+	either normally or through SIGINT, SIGTERM or SIGHUP. A signal the parent left ignored stays ignored.
+	
+	*/
+
+	static int restore_registered = 0;
+	int signals[3] = { SIGINT, SIGTERM, SIGHUP };
+	int flags;
+	int i;
+
+	flags = fcntl(fd, F_GETFL);
+
+	if (flags == -1 || (flags & O_NONBLOCK))
+		return;
+
+	if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+	{
+		if (!restore_registered)
+		{
+			restore_registered = 1;
+			atexit(restore_flags);
+
+			for (i = 0; i < 3; i++)
+				if (signal(signals[i], restore_flags_and_raise) == SIG_IGN)
+					signal(signals[i], SIG_IGN);
+		}
+
+		saved_flags[fd] = flags;
+	}
+
+	fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+	return;
+}
+
+
+void initialize_output(struct Output *output)
+{
+
+	struct stat file_status;
+
+	memset(output, 0, sizeof(*output));
+	output->batched = !isatty(STDOUT_FILENO);
+
+	if (fstat(STDOUT_FILENO, &file_status) == 0 && S_ISFIFO(file_status.st_mode))
+	{
+		set_non_blocking(STDOUT_FILENO);
+		output->pipe_size = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+
+		if (output->pipe_size < 0)
+			output->pipe_size = 0;
+	}
+
+	return;
+}
+
+
+void sample_output_pipe(struct Output *output)
+{
+
+	/*
+	
+	Function Description:
+	---------------------
+	
+	- Reads how many bytes are waiting in the standard output pipe. Every datagram carries a window, so asking the kernel for each
+	of them would cost a syscall per packet. The pipe is read only for the first window of an iteration of the main loop, which
+	clears `pipe_sampled`, and flush_output adds what it writes until the next one.
+	
+	*/
+
+	if (output->pipe_size == 0 || output->pipe_sampled)
+		return;
+
+	output->pipe_sampled = 1;
+
+	if (ioctl(STDOUT_FILENO, FIONREAD, &output->pipe_queued) < 0)
+		output->pipe_size = 0;
+
+	return;
+}
+
+
+void queue_output(struct Output *output, const char *data, long length)
+{
+
+	if (output->length + length > output->capacity)
+	{
+		output->capacity = (output->length + length) * 2;
+		output->backlog = realloc(output->backlog, output->capacity);
+	}
+
+	memcpy(output->backlog + output->length, data, length);
+	output->length += length;
+
+	return;
+}
+
+
+void flush_output(struct Output *output)
+{
+
+	if (output->length == 0)
+		return;
+
+	if (output->ring)
+	{
+		long pushed = 0;
+		struct Spsc_Slot *slot;
+
+		while (pushed < output->length && (slot = spsc_reserve(output->ring)))
+		{
+			slot->length = output->length - pushed < MAXLINE ? output->length - pushed : MAXLINE;
+			memcpy(slot->data, output->backlog + pushed, slot->length);
+			pushed += slot->length;
+			spsc_commit(output->ring);
+		}
+
+		memmove(output->backlog, output->backlog + pushed, output->length - pushed);
+		output->length -= pushed;
+
+		return;
+	}
+
+	// Lines printed with printf are still in the stdio buffer.
+	fflush(stdout);
+
+	ssize_t n = write(STDOUT_FILENO, output->backlog, output->length);
+
+	// The pipe is full, try again later.
+	if (n <= 0)
+		return;
+
+	memmove(output->backlog, output->backlog + n, output->length - n);
+	output->length -= n;
+	output->pipe_queued += n;
+
+	return;
+}
+
+
+void write_output(struct Output *output, struct iovec *run, int count)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Delivers a run of chunks. Bytes that are still waiting go first, so the order is kept.
+
+	*/
+
+	if (count == 0)
+		return;
+
+	ssize_t written = 0;
+
+	if (!output->batched && output->length == 0 && !output->ring)
+	{
+		fflush(stdout);
+		written = writev(STDOUT_FILENO, run, count);
+
+		if (written < 0)
+			written = 0;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		if (written >= (ssize_t) run[i].iov_len)
+		{
+			written -= run[i].iov_len;
+			continue;
+		}
+
+		queue_output(output, (char *) run[i].iov_base + written, run[i].iov_len - written);
+		written = 0;
+	}
+
+	if (output->length >= OUTPUT_BATCH || output->ring)
+		flush_output(output);
+
+	return;
+}
+
+
+void finish_output(struct Output *output)
+{
+
+	fcntl(STDOUT_FILENO, F_SETFL, fcntl(STDOUT_FILENO, F_GETFL) & ~O_NONBLOCK);
+
+	while (output->length)
+	{
+		long length = output->length;
+
+		flush_output(output);
+
+		// The I/O thread is still writing, wait until the ring has room.
+		if (output->length == length && output->ring)
+			usleep(OUTPUT_RETRY);
+		else if (output->length == length)
+			break;
+	}
+
+	free(output->backlog);
+
+	return;
+}
+
+
+void initialize_input(struct Input *input, int fd)
+{
+
+	struct stat file_status;
+
+	memset(input, 0, sizeof(*input));
+	input->fd = fd;
+
+	if (fstat(fd, &file_status) == 0 && (S_ISFIFO(file_status.st_mode) || S_ISSOCK(file_status.st_mode)))
+		set_non_blocking(fd);
+
+	input->drain = !isatty(fd);
+
+	return;
+}
+
+
+int split_record(struct Input *input)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Moves the next line of the block into the ring. The last line is taken without a newline only when the input has ended.
+
+	Returns:
+	--------
+
+	- 1 if a record has been added, 0 if a whole line isn't available yet.
+
+	*/
+
+	if (input->length == 0)
+		return 0;
+
+	int size = input->length < MAXLINE - 1 ? input->length : MAXLINE - 1;
+	char *line = input->block + input->start;
+	char *end = memchr(line, '\n', size);
+
+	if (end)
+		size = end - line + 1;
+	else if (size < MAXLINE - 1 && !input->closed)
+		return 0;
+
+	char *record = input->records[(input->head + input->count) % INPUT_RING];
+
+	memcpy(record, line, size);
+	record[size] = '\0';
+	input->count++;
+
+	input->start += size;
+	input->length -= size;
+
+	return 1;
+}
+
+
+void read_input(struct Input *input, int readable)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Fills the ring with the lines that are already in the block and, if stdin is readable, with what can be read without
+	blocking. Nothing is read while the ring is full. With the I/O thread, only its eventfd is cleared.
+
+	*/
+
+	int reads = 0;
+
+	if (input->ring)
+	{
+		if (readable)
+			clear_event(input->ring->consumer_event);
+
+		input->closed = __atomic_load_n(&input->ring->closed, __ATOMIC_ACQUIRE);
+		return;
+	}
+
+	while (input->count < INPUT_RING)
+	{
+		if (split_record(input))
+			continue;
+
+		if (input->closed || !readable || (!input->drain && reads))
+			break;
+
+		memmove(input->block, input->block + input->start, input->length);
+		input->start = 0;
+
+		ssize_t n = read(input->fd, input->block + input->length, INPUT_BLOCK - input->length);
+		reads++;
+
+		if (n > 0)
+			input->length += n;
+		else if (n == 0)
+			input->closed = 1;
+		else
+			break;
+	}
+
+	return;
+}
+
+
+int next_record(struct Input *input, char *message)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Takes the oldest line into `message`.
+
+	Returns:
+	--------
+
+	- 0 if no line is waiting.
+
+	*/
+
+	if (input->ring)
+	{
+		struct Spsc_Slot *slot = spsc_peek(input->ring);
+
+		if (slot == NULL)
+			return 0;
+
+		memcpy(message, slot->data, slot->length);
+		message[slot->length] = '\0';
+		input->urgent = slot->urgent;
+		spsc_release(input->ring);
+
+		return 1;
+	}
+
+	if (input->count == 0)
+		return 0;
+
+	strcpy(message, input->records[input->head]);
+
+	input->urgent = 0;
+	input->head = (input->head + 1) % INPUT_RING;
+	input->count--;
+
+	return 1;
+}
+
+
+int take_message(struct Input *input, char *message, struct Options *options)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Takes the next message to send into `message`. Without `--coalesce` it is the next line. Otherwise the waiting lines are packed
+	into one message, each one after a 1 byte length, as long as they fit into MAXLINE - 1 bytes. Lines pile up while a message is
+	in flight, so a chatty writer gets many lines into one message instead of one line per round trip. If the batch could still
+	grow, it is held for at most `coalesce_delay` microseconds after the sender became free. An urgent line (see `input->urgent`),
+	a line that doesn't fit or the end of the input sends it right away. An urgent line or a line that doesn't fit into an empty
+	batch is sent alone, as it is. "BYE\n" is taken on its own as well, it closes the session instead of being sent.
+
+	Returns:
+	--------
+
+	- 1 if a message has been taken. `input->coalesced` tells whether it is packed.
+
+	*/
+
+	if (!options->coalesce)
+	{
+		input->coalesced = 0;
+		return next_record(input, message);
+	}
+
+	while (input->has_next || next_record(input, input->next))
+	{
+		int length = strlen(input->next);
+
+		input->has_next = 1;
+
+		if (input->urgent || strcmp(input->next, "BYE\n") == 0 || input->batch_length + 1 + length > MAXLINE - 1)
+			break;
+
+		input->batch[input->batch_length++] = length;
+		memcpy(input->batch + input->batch_length, input->next, length);
+		input->batch_length += length;
+		input->has_next = 0;
+	}
+
+	if (input->batch_length == 0)
+	{
+		if (!input->has_next)
+			return 0;
+
+		strcpy(message, input->next);
+		input->has_next = 0;
+		input->coalesced = 0;
+
+		return 1;
+	}
+
+	if (input->batch_time == 0)
+		input->batch_time = current_time_in_microseconds();
+
+	if (!input->has_next && !input->closed && current_time_in_microseconds() - input->batch_time < options->coalesce_delay)
+		return 0;
+
+	memcpy(message, input->batch, input->batch_length);
+	message[input->batch_length] = '\0';
+
+	input->batch_length = 0;
+	input->batch_time = 0;
+	input->coalesced = 1;
+
+	return 1;
+}
+
+
+void* run_io_thread(void *argument)
+{
+
+	struct Io_Thread *io = argument;
+	struct Input *reader = &io->reader;
+	struct Input *urgent = &io->urgent_reader;
+	struct Spsc_Slot *slot;
+	struct pollfd poll_fd[3];
+
+	poll_fd[1].fd = io->wake_event;
+	poll_fd[1].events = POLLIN;
+	poll_fd[0].events = POLLIN;
+	poll_fd[2].events = POLLIN;
+
+	while (1)
+	{
+		// Lines of the urgent input don't wait behind those of stdin.
+		while ((urgent->count || reader->count) && (slot = spsc_reserve(&io->input)))
+		{
+			slot->urgent = urgent->count != 0;
+			next_record(slot->urgent ? urgent : reader, slot->data);
+			slot->length = strlen(slot->data);
+			spsc_commit(&io->input);
+		}
+
+		if (reader->closed && reader->count == 0 && !io->input.closed)
+		{
+			__atomic_store_n(&io->input.closed, 1, __ATOMIC_RELEASE);
+			signal_event(io->input_event);
+		}
+
+		// Writes may block here, that only holds the output ring back.
+		while ((slot = spsc_peek(&io->output)))
+		{
+			for (int written = 0, n; written < slot->length; written += n)
+				if ((n = write(STDOUT_FILENO, slot->data + written, slot->length - written)) <= 0)
+					break;
+
+			spsc_release(&io->output);
+		}
+
+		if (__atomic_load_n(&io->stop, __ATOMIC_ACQUIRE) && spsc_count(&io->output) == 0)
+			break;
+
+		poll_fd[0].fd = reader->count == INPUT_RING || reader->closed ? -1 : reader->fd;
+		poll_fd[2].fd = urgent->count == INPUT_RING || urgent->closed ? -1 : urgent->fd;
+
+		if (poll(poll_fd, 3, -1) < 0)
+			continue;
+
+		if (poll_fd[1].revents & POLLIN)
+			clear_event(io->wake_event);
+
+		read_input(reader, poll_fd[0].revents & (POLLIN | POLLHUP));
+		read_input(urgent, poll_fd[2].revents & (POLLIN | POLLHUP));
+	}
+
+	return NULL;
+}
+
+
+int start_io_thread(struct Io_Thread *io, struct Input *input, struct Output *output, void *(*routine)(void *))
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Connects `input` and `output` of the main loop to the rings and starts `routine` on the thread. Standard output is written by
+	the thread, so it is made blocking again.
+
+	Returns:
+	--------
+
+	- 0 on success, -1 if the thread couldn't be started and the main loop does its own I/O.
+
+	*/
+
+	io->input_event = eventfd(0, EFD_NONBLOCK);
+	io->wake_event = eventfd(0, EFD_NONBLOCK);
+	io->stop = 0;
+
+	initialize_spsc_ring(&io->input, io->input_event, io->wake_event);
+	initialize_spsc_ring(&io->output, io->wake_event, -1);
+	initialize_input(&io->reader, STDIN_FILENO);
+	initialize_input(&io->urgent_reader, io->urgent_fd);
+
+	if (io->input_event < 0 || io->wake_event < 0 || pthread_create(&io->thread, NULL, routine, io) != 0)
+	{
+		close(io->input_event);
+		close(io->wake_event);
+		return -1;
+	}
+
+	input->ring = &io->input;
+	output->ring = &io->output;
+
+	fcntl(STDOUT_FILENO, F_SETFL, fcntl(STDOUT_FILENO, F_GETFL) & ~O_NONBLOCK);
+
+	return 0;
+}
+
+
+void stop_io_thread(struct Io_Thread *io)
+{
+
+	__atomic_store_n(&io->stop, 1, __ATOMIC_RELEASE);
+	signal_event(io->wake_event);
+
+	pthread_join(io->thread, NULL);
+
+	close(io->input_event);
+	close(io->wake_event);
+
+	if (io->urgent_fd >= 0)
+		close(io->urgent_fd);
+
+	return;
+}
+
+
+// -------------------------------------------------Daemon------------------------------------------------------------------------//
+int open_daemon_socket(const char *path)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Listens for applications on `path`. A socket file left over from an earlier daemon is replaced. The socket file is created
+	with mode 0600, so only the user of the daemon can connect (see also accept_application).
+
+	Returns:
+	--------
+
+	- The listening socket, -1 on error.
+
+	*/
+
+	struct sockaddr_un address;
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+	unlink(path);
+
+	mode_t mask = umask(0077);
+	int bound = fd >= 0 && bind(fd, (struct sockaddr *) &address, sizeof(address)) == 0;
+
+	umask(mask);
+
+	if (!bound || listen(fd, DAEMON_APPLICATIONS) < 0)
+	{
+		if (fd >= 0)
+			close(fd);
+
+		return -1;
+	}
+
+	return fd;
+}
+
+
+int accept_application(int listen_fd)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Accepts the next application. Its credentials are checked as well, in case the socket file has been made reachable to other
+	users: an application of another user could write into the shared rings and the input of the daemon.
+
+	Returns:
+	--------
+
+	- Connected socket, -1 if there is none or it belongs to another user.
+
+	*/
+
+	struct ucred peer;
+	socklen_t length = sizeof(peer);
+	int fd = accept(listen_fd, NULL, NULL);
+
+	if (fd >= 0 && (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) < 0 || peer.uid != getuid()))
+	{
+		fprintf(stderr, "APPLICATION: refused, it belongs to another user\n");
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+int share_rings(struct Application *application)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Maps the shared rings of `application` and sends it the memfd and both doorbells with SCM_RIGHTS.
+
+	Returns:
+	--------
+
+	- 0 on success, -1 on error.
+
+	*/
+
+	int memfd = memfd_create("rdt-rings", MFD_CLOEXEC);
+	int fds[3] = { memfd, eventfd(0, EFD_NONBLOCK), eventfd(0, EFD_NONBLOCK) };
+	char control[CMSG_SPACE(sizeof(fds))];
+	char greeting = '\0';
+	struct iovec data = { &greeting, 1 };
+	struct msghdr header;
+
+	application->doorbell = fds[1];
+	application->peer_doorbell = fds[2];
+
+	if (memfd < 0 || fds[1] < 0 || fds[2] < 0 || ftruncate(memfd, sizeof(struct Shared_Rings)) < 0)
+	{
+		close(memfd);
+		return -1;
+	}
+
+	application->shared = mmap(NULL, sizeof(struct Shared_Rings), PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+
+	if (application->shared == MAP_FAILED)
+	{
+		application->shared = NULL;
+		close(memfd);
+		return -1;
+	}
+
+	initialize_spsc_ring(&application->shared->to_daemon, -1, application->peer_doorbell);
+	initialize_spsc_ring(&application->shared->to_application, application->peer_doorbell, -1);
+
+	memset(&header, 0, sizeof(header));
+	header.msg_iov = &data;
+	header.msg_iovlen = 1;
+	header.msg_control = control;
+	header.msg_controllen = sizeof(control);
+
+	struct cmsghdr *control_message = CMSG_FIRSTHDR(&header);
+
+	control_message->cmsg_level = SOL_SOCKET;
+	control_message->cmsg_type = SCM_RIGHTS;
+	control_message->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(control_message), fds, sizeof(fds));
+
+	ssize_t sent = sendmsg(application->fd, &header, MSG_NOSIGNAL);
+
+	close(memfd);
+
+	return sent == 1 ? 0 : -1;
+}
+
+
+void detach_application(struct Application **applications, int index, const char *reason)
+{
+
+	struct Application *application = applications[index];
+
+	fprintf(stderr, "APPLICATION: %d %s\n", index, reason);
+
+	if (application->shared)
+	{
+		munmap(application->shared, sizeof(struct Shared_Rings));
+		close(application->doorbell);
+		close(application->peer_doorbell);
+	}
+
+	close(application->fd);
+	free(application);
+	applications[index] = NULL;
+
+	return;
+}
+
+
+void greet_application(struct Application **applications, int index)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Looks at the first byte of a new application. '\0' asks for shared rings, anything else is the start of its first line.
+
+	*/
+
+	struct Application *application = applications[index];
+	char first;
+
+	if (recv(application->fd, &first, 1, MSG_PEEK | MSG_DONTWAIT) != 1)
+		return;
+
+	application->greeted = 1;
+
+	if (first != '\0')
+		return;
+
+	if (recv(application->fd, &first, 1, MSG_DONTWAIT) != 1 || share_rings(application) < 0)
+		detach_application(applications, index, "detached, shared rings couldn't be set up");
+
+	return;
+}
+
+
+int shared_slot_length(struct Spsc_Slot *slot, int limit)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- The other process can change a slot of the shared rings at any time, so its length is read only once and checked.
+
+	Returns:
+	--------
+
+	- Length of the slot, -1 if it is not in [0, limit].
+
+	*/
+
+	int length = __atomic_load_n(&slot->length, __ATOMIC_RELAXED);
+
+	return length >= 0 && length <= limit ? length : -1;
+}
+
+
+int push_application_line(struct Application *application, struct Spsc_Ring *input)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Moves the next line of `application` into the input ring of the main loop.
+
+	Returns:
+	--------
+
+	- 1 if a line has been moved, -1 if the shared ring holds a line that doesn't fit into a slot.
+
+	*/
+
+	struct Spsc_Slot *line = application->shared ? spsc_peek(&application->shared->to_daemon) : NULL;
+	struct Spsc_Slot *slot;
+
+	if ((line == NULL && application->reader.count == 0) || (slot = spsc_reserve(input)) == NULL)
+		return 0;
+
+	if (line)
+	{
+		int length = shared_slot_length(line, MAXLINE - 1);
+
+		if (length < 0)
+			return -1;
+
+		memcpy(slot->data, line->data, length);
+		slot->length = length;
+		slot->data[length] = '\0';
+		slot->urgent = __atomic_load_n(&line->urgent, __ATOMIC_RELAXED) != 0;
+		spsc_release(&application->shared->to_daemon);
+	}
+	else
+	{
+		next_record(&application->reader, slot->data);
+		slot->length = strlen(slot->data);
+		slot->urgent = 0;
+	}
+
+	spsc_commit(input);
+
+	return 1;
+}
+
+
+int deliver_to_application(struct Application *application, struct Spsc_Slot *slot)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Hands delivered bytes to `application` without blocking.
+
+	Returns:
+	--------
+
+	- 0 if its ring or socket buffer is full.
+
+	*/
+
+	struct Spsc_Slot *copy;
+
+	if (application->shared == NULL)
+		return send(application->fd, slot->data, slot->length, MSG_DONTWAIT | MSG_NOSIGNAL) == slot->length;
+
+	if ((copy = spsc_reserve(&application->shared->to_application)) == NULL)
+		return 0;
+
+	memcpy(copy->data, slot->data, slot->length);
+	copy->length = slot->length;
+	spsc_commit(&application->shared->to_application);
+
+	return 1;
+}
+
+
+int application_done(struct Application *application)
+{
+
+	if (application->shared)
+		return __atomic_load_n(&application->shared->to_daemon.closed, __ATOMIC_ACQUIRE) && spsc_count(&application->shared->to_daemon) == 0;
+
+	return application->reader.closed && application->reader.count == 0;
+}
+
+
+void* run_daemon_thread(void *argument)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- I/O thread of the daemon. Lines of the applications are pushed into the input ring, one application after the other so a
+	chatty one doesn't hold back the rest. Delivered bytes are written to every application without blocking. An application
+	whose socket buffer or ring is full is detached, it would hold back the others.
+
+	*/
+
+	struct Io_Thread *io = argument;
+	struct Application *applications[DAEMON_APPLICATIONS] = { NULL };
+	struct pollfd poll_fd[2 + 2 * DAEMON_APPLICATIONS];
+	struct pollfd *doorbells = poll_fd + 2 + DAEMON_APPLICATIONS;
+	struct Spsc_Slot *slot;
+	int turn = 0;
+
+	poll_fd[0].fd = io->listen_fd;
+	poll_fd[1].fd = io->wake_event;
+
+	for (int i = 0; i < 2 + 2 * DAEMON_APPLICATIONS; i++)
+		poll_fd[i].events = POLLIN;
+
+	while (1)
+	{
+		for (int pushed = 1; pushed; turn = (turn + 1) % DAEMON_APPLICATIONS)
+		{
+			pushed = 0;
+
+			for (int i = 0; i < DAEMON_APPLICATIONS; i++)
+			{
+				int index = (turn + i) % DAEMON_APPLICATIONS;
+				int moved = applications[index] ? push_application_line(applications[index], &io->input) : 0;
+
+				if (moved < 0)
+					detach_application(applications, index, "detached, it sent a line longer than MAXLINE");
+				else
+					pushed |= moved;
+			}
+		}
+
+		while ((slot = spsc_peek(&io->output)))
+		{
+			for (int i = 0; i < DAEMON_APPLICATIONS; i++)
+				if (applications[i] && applications[i]->greeted && !deliver_to_application(applications[i], slot))
+					detach_application(applications, i, "detached, it doesn't keep up");
+
+			spsc_release(&io->output);
+		}
+
+		if (__atomic_load_n(&io->stop, __ATOMIC_ACQUIRE) && spsc_count(&io->output) == 0)
+			break;
+
+		// With shared rings, the socket is only watched for hang up and the doorbell for lines.
+		for (int i = 0; i < DAEMON_APPLICATIONS; i++)
+		{
+			struct Application *application = applications[i];
+
+			poll_fd[2 + i].fd = application ? application->fd : -1;
+			poll_fd[2 + i].events = application && !application->shared && application->reader.count < INPUT_RING ? POLLIN : 0;
+			doorbells[i].fd = application && application->shared ? application->doorbell : -1;
+		}
+
+		if (poll(poll_fd, 2 + 2 * DAEMON_APPLICATIONS, -1) < 0)
+			continue;
+
+		if (poll_fd[1].revents & POLLIN)
+			clear_event(io->wake_event);
+
+		if (poll_fd[0].revents & POLLIN)
+		{
+			int fd = accept_application(io->listen_fd);
+			int index = 0;
+
+			while (index < DAEMON_APPLICATIONS && applications[index])
+				index++;
+
+			if (fd >= 0 && index == DAEMON_APPLICATIONS)
+				close(fd);
+
+			else if (fd >= 0)
+			{
+				applications[index] = malloc(sizeof(struct Application));
+				memset(applications[index], 0, sizeof(struct Application));
+				applications[index]->fd = fd;
+				initialize_input(&applications[index]->reader, fd);
+				fprintf(stderr, "APPLICATION: %d attached\n", index);
+			}
+		}
+
+		// An application that has closed its end is detached once its lines are in the ring.
+		for (int i = 0; i < DAEMON_APPLICATIONS; i++)
+		{
+			if (applications[i] && (doorbells[i].revents & POLLIN))
+				clear_event(applications[i]->doorbell);
+
+			if (applications[i] && applications[i]->shared && (poll_fd[2 + i].revents & (POLLHUP | POLLERR)))
+			{
+				detach_application(applications, i, "detached");
+				continue;
+			}
+
+			if (applications[i] && !applications[i]->greeted && (poll_fd[2 + i].revents & (POLLIN | POLLHUP)))
+				greet_application(applications, i);
+
+			if (applications[i] && !applications[i]->shared && (poll_fd[2 + i].revents & (POLLIN | POLLHUP)))
+				read_input(&applications[i]->reader, 1);
+
+			if (applications[i] && application_done(applications[i]))
+				detach_application(applications, i, "detached");
+		}
+	}
+
+	for (int i = 0; i < DAEMON_APPLICATIONS; i++)
+		if (applications[i])
+			detach_application(applications, i, "detached");
+
+	close(io->listen_fd);
+	unlink(io->path);
+
+	return NULL;
+}
+
+
+int attach_daemon(const char *path)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Client side of the daemon. The returned socket takes lines to send, and what the peer sends can be read from it.
+
+	Returns:
+	--------
+
+	- Connected socket, -1 if no daemon listens on `path`.
+
+	*/
+
+	struct sockaddr_un address;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+	if (fd >= 0 && connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+
+struct Shared_Rings* attach_shared(int fd, int *doorbell, int *daemon_doorbell)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Asks the daemon on `fd` for shared rings. Lines are then pushed into `to_daemon` and delivered bytes popped from
+	`to_application`. The application waits on `doorbell`, and the rings ring `daemon_doorbell` for it.
+
+	Returns:
+	--------
+
+	- The mapped rings, NULL on error.
+
+	*/
+
+	int fds[3];
+	char control[CMSG_SPACE(sizeof(fds))];
+	char greeting = '\0';
+	struct iovec data = { &greeting, 1 };
+	struct msghdr header;
+
+	memset(&header, 0, sizeof(header));
+	header.msg_iov = &data;
+	header.msg_iovlen = 1;
+	header.msg_control = control;
+	header.msg_controllen = sizeof(control);
+
+	if (send(fd, &greeting, 1, MSG_NOSIGNAL) != 1 || recvmsg(fd, &header, 0) != 1)
+		return NULL;
+
+	struct cmsghdr *control_message = CMSG_FIRSTHDR(&header);
+
+	if (control_message == NULL || control_message->cmsg_type != SCM_RIGHTS || control_message->cmsg_len != CMSG_LEN(sizeof(fds)))
+		return NULL;
+
+	memcpy(fds, CMSG_DATA(control_message), sizeof(fds));
+
+	struct Shared_Rings *shared = mmap(NULL, sizeof(struct Shared_Rings), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+
+	close(fds[0]);
+
+	if (shared == MAP_FAILED)
+		return NULL;
+
+	*daemon_doorbell = fds[1];
+	*doorbell = fds[2];
+	shared->to_daemon.consumer_event = *daemon_doorbell;
+	shared->to_application.producer_event = *daemon_doorbell;
+
+	return shared;
+}
+
+
+void run_attached(const char *path, int urgent)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- `--attach <path> [--urgent]`: lines of stdin go into the shared ring of the daemon, and what it delivers goes to stdout. When
+	stdin ends, the daemon detaches the application once it has taken every line. With `--urgent`, every line is flagged latency
+	critical, so the daemon never holds it back to pack it with other lines.
+
+	*/
+
+	int fd = attach_daemon(path);
+	int doorbell, daemon_doorbell, hung_up = 0;
+	struct Shared_Rings *shared = fd < 0 ? NULL : attach_shared(fd, &doorbell, &daemon_doorbell);
+	struct Input *reader = malloc(sizeof(struct Input));
+	struct Spsc_Slot *slot;
+	struct pollfd poll_fd[3];
+
+	if (shared == NULL)
+	{
+		fprintf(stderr, "No daemon listens on %s!\n", path);
+		exit(-1);
+	}
+
+	initialize_input(reader, STDIN_FILENO);
+
+	poll_fd[0].fd = fd;
+	poll_fd[0].events = 0;
+	poll_fd[1].fd = doorbell;
+	poll_fd[1].events = POLLIN;
+	poll_fd[2].events = POLLIN;
+
+	while (1)
+	{
+		// Lines are split straight into the shared ring.
+		while (reader->count && (slot = spsc_reserve(&shared->to_daemon)))
+		{
+			next_record(reader, slot->data);
+			slot->length = strlen(slot->data);
+			slot->urgent = urgent;
+			spsc_commit(&shared->to_daemon);
+		}
+
+		if (reader->closed && reader->count == 0 && !shared->to_daemon.closed)
+		{
+			__atomic_store_n(&shared->to_daemon.closed, 1, __ATOMIC_RELEASE);
+			signal_event(daemon_doorbell);
+		}
+
+		while ((slot = spsc_peek(&shared->to_application)))
+		{
+			int length = shared_slot_length(slot, MAXLINE);
+
+			for (int written = 0, n; written < length; written += n)
+				if ((n = write(STDOUT_FILENO, slot->data + written, length - written)) <= 0)
+					break;
+
+			spsc_release(&shared->to_application);
+		}
+
+		if (hung_up)
+			break;
+
+		poll_fd[2].fd = reader->count == INPUT_RING || reader->closed ? -1 : STDIN_FILENO;
+
+		if (poll(poll_fd, 3, -1) < 0)
+			continue;
+
+		hung_up = poll_fd[0].revents & (POLLHUP | POLLERR);
+
+		if (poll_fd[1].revents & POLLIN)
+			clear_event(doorbell);
+
+		read_input(reader, poll_fd[2].revents & (POLLIN | POLLHUP));
+	}
+
+	munmap(shared, sizeof(struct Shared_Rings));
+	close(doorbell);
+	close(daemon_doorbell);
+	close(fd);
+	free(reader);
+
+	return;
+}
+
+
+struct Relay_Message* new_relay_message()
+{
+
+	struct Relay_Message *relay = malloc(sizeof(struct Relay_Message));
+
+	memset(relay, 0, sizeof(*relay));
+	relay->references = 1;
+
+	for (int i = 0; i < 32; i++)
+		relay->chunks[i] = relay->chunk_data[i];
+
+	return relay;
+}
+
+
+void release_relay_message(struct Relay_Message *relay)
+{
+
+	if (relay && --relay->references == 0)
+		free(relay);
+
+	return;
+}
+
+
+int packet_index(struct Window *window, int sqNo)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Maps a circular sequence number inside the window to its index in `window.packets`. If the sequence number is smaller than the
+	window start, it has already wrapped around, so it belongs to the next pass.
+
+	*/
+
+	return (window->pass + (window->sequence_number > sqNo)) * 2 * window->window_size + sqNo;
+}
+
+
+void store_chunk(struct Window *window, int index, struct UDP_Datagram *packet)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Keeps a sent chunk in the window for retransmission and starts its timer.
+
+	*/
+
+	window->packets[index] = *packet;
+	window->deadline[index] = (unsigned int) (time_in_microseconds(&packet->timeout_time) + TIME_OUT);
+	window->buffer_available--;
+	window->last_activity = time_in_microseconds(&packet->timeout_time);
+	window->probe_sent = 0;
+
+	return;
+}
+
+
+void arm_timer(struct Window *window, int index)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Restarts the timer of a chunk that is sent again. `timeout_time` is echoed by the ACK for the round trip time sample, 
+	`deadline` is what the timeout scan reads.
+
+	*/
+
+	gettimeofday(&window->packets[index].timeout_time, NULL);
+	window->deadline[index] = (unsigned int) (time_in_microseconds(&window->packets[index].timeout_time) + TIME_OUT);
+
+	return;
+}
+
+
+int timer_expired(struct Window *window, int index, long now)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Whether the deadline of the chunk has passed. The difference of the 32 bit values is taken as signed, so it stays correct when
+	the clock wraps around (about 71 minutes).
+
+	*/
+
+	return (int) ((unsigned int) now - window->deadline[index]) > 0;
+}
+
+
+unsigned long unacked_chunks(struct Window *window, int end)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Bits of the chunks in [0, end) that are not ACKed yet. The chunks before the window start are all ACKed, so these are the
+	chunks in flight. Callers visit them with `missing &= missing - 1` instead of testing every chunk of the window.
+
+	*/
+
+	return ((1UL << end) - 1) & ~window->acked;
+}
+
+
+unsigned long rotate_slots(unsigned long slots, int from, int sequence_space)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- `slots` has one bit per slot of the circular sequence space. Returns them in order starting from slot `from`, so that bit 0 is
+	`from` and the bits after it follow around the circle.
+
+	*/
+
+	return (slots >> from | slots << (sequence_space - from)) & ((1UL << sequence_space) - 1);
+}
+
+
+int usable_window(struct Window *window, struct Flow_Control *flow)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Number of new chunks that can be sent now. Chunks after the window start count against min(window_size, peer_window), the first
+	one is the congestion window limit (fixed to window size here) and the second one is the flow control limit of the receiver.
+
+	*/
+
+	int limit = flow->peer_window < window->window_size ? flow->peer_window : window->window_size;
+
+	return limit - (window->window_size - window->buffer_available);
+}
+
+
+long socket_buffer_size(struct Window *window, struct Options *options)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Socket buffer space needed for one window of data packets and their parity packets. Nothing beyond the window can be in
+	flight, so it also bounds the bandwidth-delay product. The kernel charges every datagram with its own overhead on top of the
+	payload, so packets are counted with SOCKET_BUFFER_OVERHEAD, and SOCKET_BUFFER_HEADROOM windows are kept for bursts and
+	retransmissions.
+
+	*/
+
+	long packets = window->window_size;
+
+	if (options->fec_parity && options->fec_group > 0)
+		packets += (window->window_size + options->fec_group - 1) / options->fec_group * options->fec_parity;
+
+	return packets * (DATAGRAM_HEADER_SIZE + SOCKET_BUFFER_OVERHEAD) * SOCKET_BUFFER_HEADROOM;
+}
+
+
+int advertised_window(int window_size, struct Ack_State *ack_state)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Receiver can reassemble `window_size` chunks after the next chunk to be printed, less the chunks that have arrived out of order
+	and already take a slot there (`waiting`). Printed chunks go into the standard output, and if the application reading it drains
+	slowly, that pipe fills up and printing blocks the whole loop. So the window is also limited by the free space left in the pipe
+	(in 8 byte chunks), minus everything that will still be written into it: the backlog of the output (at most a full slot for each
+	slot in the ring of the I/O thread), the text of a message that is held until it is complete, and the chunks waiting in the
+	reassembly. When standard output is not a pipe, only the reassembly space is used. The pipe is not asked for every datagram,
+	its size and fill level are kept in the Output (see sample_output_pipe).
+
+	*/
+
+	struct Output *output = ack_state->output;
+	int waiting = __builtin_popcountl(ack_state->waiting);
+	int window = window_size - waiting;
+
+	sample_output_pipe(output);
+
+	if (output->pipe_size > 0)
+	{
+		long pending = output->length + (output->ring ? spsc_count(output->ring) * MAXLINE : 0) + ack_state->held_length + waiting * 8;
+		int free_chunks = (output->pipe_size - output->pipe_queued - pending) / 8;
+
+		if (free_chunks < window)
+			window = free_chunks;
+	}
+
+	return window < 0 ? 0 : window;
+}
+
+
+int next_poll_time_out(struct Window *window, struct RTT_Estimator *rtt, struct Flow_Control *flow, int start, int end, int is_tail)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Finds the earliest timer among the unACKed packets in [start, end) and, when the tail of the message is in flight, the tail loss probe.
+	When the receiver has closed its window and nothing is in flight, the zero window probe timer is used as well.
+	Poll is not allowed to sleep longer than that, otherwise the Timeout block would only run every POLL_TIME_OUT milliseconds.
+
+	Returns:
+	--------
+
+	- Poll timeout in microseconds.
+
+	*/
+
+	long now = current_time_in_microseconds();
+	long deadline = now + POLL_TIME_OUT * 1000L;
+
+	for (unsigned long missing = unacked_chunks(window, end); missing; missing &= missing - 1)
+	{
+		int i = __builtin_ctzl(missing);
+		long packet_deadline = now + (int) (window->deadline[i] - (unsigned int) now);
+
+		if (packet_deadline < deadline)
+			deadline = packet_deadline;
+	}
+
+	if (is_tail && !window->probe_sent && window->last_activity + probe_time_out(rtt) < deadline)
+		deadline = window->last_activity + probe_time_out(rtt);
+
+	if (!is_tail && flow->peer_window == 0 && start == end && window->last_activity + flow->persist_time_out < deadline)
+		deadline = window->last_activity + flow->persist_time_out;
+
+	if (deadline <= now)
+		return 0;
+
+	return deadline - now;
+}
+
+
+struct UDP_Datagram* create_packet(char *partitioned_message, int sqNo)
+{
+	
+	struct UDP_Datagram *packet; 
+	packet = (struct UDP_Datagram*) malloc(sizeof(struct UDP_Datagram));
+
+	memset(packet, 0, sizeof(struct UDP_Datagram));
+
+	packet->type = DATA_PACKET;
+	packet->sqNo = sqNo;
+	packet->is_ACKed = 0;
+	
+	memcpy(packet->payload, partitioned_message, 8);
+	packet->payload[8] = '\0';
+	gettimeofday(&(packet->timeout_time), NULL);
+
+	return packet;
+}
+
+
+char **partition_message(char* message, char **partitioned_message)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Divides the message into the 32 chunks of `partitioned_message`, which are reused for every message.
+
+	Returns:
+	--------
+		
+	- A String array, containing the chunks corresponding the message
+
+	*/
+    
+    for (int i = 0 ; i < 32; i++)
+        memset(partitioned_message[i], 0, 8);
+    
+    int len = strlen(message);
+    
+    int k = -1, t = 0;
+
+    for (int i = 0; i < len; i++)
+    {
+    	if (i % 8 == 0)
+    	{
+    		k++;
+    		t = 0;
+    	}
+		
+		partitioned_message[k][t++] = message[i];    	
+    }
+
+    return partitioned_message; 
+}
+
+
+// -------------------------------------------------File Transfer-----------------------------------------------------------------//
+void open_file_transfer(struct File_Transfer *outgoing, struct File_Transfer *incoming, struct Options *options)
+{
+
+	memset(outgoing, 0, sizeof(*outgoing));
+	memset(incoming, 0, sizeof(*incoming));
+	outgoing->fd = -1;
+	incoming->fd = -1;
+	outgoing->digest = FNV_OFFSET_BASIS;
+
+	if (options->send_file)
+	{
+		struct stat file_status;
+
+		outgoing->fd = open(options->send_file, O_RDONLY);
+
+		if (outgoing->fd < 0 || fstat(outgoing->fd, &file_status) < 0)
+		{
+			fprintf(stderr, "Can't open %s\n", options->send_file);
+			exit(-1);
+		}
+
+		outgoing->size = file_status.st_size;
+
+		if (outgoing->size > 0)
+		{
+			outgoing->data = mmap(NULL, outgoing->size, PROT_READ, MAP_PRIVATE, outgoing->fd, 0);
+
+			if (outgoing->data == MAP_FAILED)
+			{
+				fprintf(stderr, "Can't map %s\n", options->send_file);
+				exit(-1);
+			}
+
+			// The digest identifies the file in the resume handshake, so it is needed before the first chunk.
+			madvise(outgoing->data, outgoing->size, MADV_SEQUENTIAL);
+			outgoing->digest = fnv1a(FNV_OFFSET_BASIS, outgoing->data, outgoing->size);
+		}
+
+		outgoing->start_time = current_time_in_microseconds();
+		outgoing->session = outgoing->start_time;
+	}
+
+	if (options->receive_file)
+	{
+		incoming->fd = open(options->receive_file, O_RDWR | O_CREAT, 0644);
+
+		if (incoming->fd < 0)
+		{
+			fprintf(stderr, "Can't open %s\n", options->receive_file);
+			exit(-1);
+		}
+
+		snprintf(incoming->bitmap_path, sizeof(incoming->bitmap_path), "%s.bitmap", options->receive_file);
+	}
+
+	return;
+}
+
+
+int next_file_message(struct File_Transfer *file)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Cuts the next MAXLINE bytes of the file into chunks.
+
+	Returns:
+	--------
+
+	- Number of chunks in the message.
+
+	*/
+
+	long length = file->size - file->offset < MAXLINE ? file->size - file->offset : MAXLINE;
+
+	file->message_offset = file->offset;
+
+	// The last chunk may be shorter than 8 bytes. Reading the rest of it stays in the last page of the mapping, which is zero filled.
+	for (int i = 0; i * 8 < length; i++)
+		file->chunks[i] = file->data + file->offset + i * 8;
+
+	file->offset += length;
+	file->transferred += length;
+
+	return (length + 7) / 8;
+}
+
+
+void stamp_file_chunk(struct File_Transfer *file, struct UDP_Datagram *packet)
+{
+
+	packet->file_offset = file->message_offset;
+
+	return;
+}
+
+
+long file_chunk_offset(struct File_Transfer *file, struct UDP_Datagram *chunk, int *length)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Every message of a file has MAXLINE bytes except the last one, so the position of a chunk in its message follows from
+	`remained`. The size of the file is the one the RESUME_REQUEST told the receiver.
+
+	- `file_offset` and `remained` come from the peer and decide where the chunk is written and which bit of the bitmap it sets,
+	so they are checked first: the message has to start inside the file on a MAXLINE boundary and the chunk has to be one of its
+	chunks.
+
+	Returns:
+	--------
+
+	- Offset of the chunk in the file, and its length in `length`. -1 if it isn't a file chunk, or doesn't lie inside the file.
+
+	*/
+
+	if (chunk->stream != STREAM_FILE || file->size <= 0 || chunk->file_offset < 0 || chunk->file_offset >= file->size ||
+		chunk->file_offset % MAXLINE)
+		return -1;
+
+	long message_length = file->size - chunk->file_offset < MAXLINE ? file->size - chunk->file_offset : MAXLINE;
+
+	if (chunk->remained < 0 || chunk->remained >= (message_length + 7) / 8)
+		return -1;
+
+	int index = (message_length + 7) / 8 - 1 - chunk->remained;
+	long offset = chunk->file_offset + index * 8;
+
+	*length = file->size - offset < 8 ? file->size - offset : 8;
+
+	return offset;
+}
+
+
+void report_file_transfer(struct File_Transfer *file, const char *result)
+{
+
+	double seconds = (current_time_in_microseconds() - file->start_time) / 1000000.0;
+
+	if (file->transferred < file->size)
+		fprintf(stderr, "FILE: %ld bytes, %ld of them in this run, in %.3f s (%.2f MB/s), digest %016lx %s\n", file->size,
+				file->transferred, seconds, seconds > 0 ? file->transferred / seconds / 1000000.0 : 0.0, file->digest, result);
+
+	else
+		fprintf(stderr, "FILE: %ld bytes in %.3f s (%.2f MB/s), digest %016lx %s\n", file->size, seconds,
+				seconds > 0 ? file->size / seconds / 1000000.0 : 0.0, file->digest, result);
+
+	return;
+}
+
+
+void checkpoint_incoming(struct File_Transfer *file)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- The output file is synced first, so that the bitmap on disk never claims a chunk that could still be lost.
+
+	*/
+
+	fdatasync(file->fd);
+	memcpy(file->checkpoint->bits, file->bits, file->bitmap_size - sizeof(struct Resume_Bitmap));
+	file->checkpoint->received = file->received;
+	msync(file->checkpoint, file->bitmap_size, MS_ASYNC);
+	file->last_checkpoint = current_time_in_microseconds();
+
+	return;
+}
+
+
+void finish_incoming(struct File_Transfer *file)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Every chunk is in the output file. Its digest is computed from the file itself, since parts of it may have been written by
+	an earlier run.
+
+	*/
+
+	unsigned long digest = FNV_OFFSET_BASIS;
+
+	checkpoint_incoming(file);
+
+	char *data = mmap(NULL, file->size, PROT_READ, MAP_SHARED, file->fd, 0);
+
+	if (data != MAP_FAILED)
+	{
+		digest = fnv1a(digest, data, file->size);
+		munmap(data, file->size);
+	}
+
+	report_file_transfer(file, digest == file->digest ? "OK" : "MISMATCH");
+
+	// A mismatching file is sent again from the start next time.
+	unlink(file->bitmap_path);
+	file->done = 1;
+
+	return;
+}
+
+
+void prepare_incoming(struct File_Transfer *file, long size, unsigned long digest)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Maps the bitmap of the file that is being received. A bitmap left by an earlier run is used if it belongs to the same file
+	(same size and digest), otherwise it is cleared along with the output file.
+
+	*/
+
+	if (file->fd < 0 || (file->bits && file->size == size && file->digest == digest))
+		return;
+
+	if (file->bits)
+	{
+		munmap(file->checkpoint, file->bitmap_size);
+		free(file->bits);
+	}
+
+	long words = (size + MAXLINE - 1) / MAXLINE;
+	struct stat file_status;
+	int bitmap_fd = open(file->bitmap_path, O_RDWR | O_CREAT, 0644);
+
+	file->bitmap_size = sizeof(struct Resume_Bitmap) + words * sizeof(unsigned int);
+
+	if (bitmap_fd < 0 || fstat(bitmap_fd, &file_status) < 0 || ftruncate(bitmap_fd, file->bitmap_size) < 0)
+	{
+		fprintf(stderr, "Can't open %s\n", file->bitmap_path);
+		exit(-1);
+	}
+
+	file->checkpoint = mmap(NULL, file->bitmap_size, PROT_READ | PROT_WRITE, MAP_SHARED, bitmap_fd, 0);
+	close(bitmap_fd);
+
+	if (file->checkpoint == MAP_FAILED)
+	{
+		fprintf(stderr, "Can't map %s\n", file->bitmap_path);
+		exit(-1);
+	}
+
+	if (file_status.st_size != file->bitmap_size || file->checkpoint->magic != RESUME_MAGIC ||
+		file->checkpoint->file_size != size || file->checkpoint->file_digest != digest)
+	{
+		memset(file->checkpoint, 0, file->bitmap_size);
+		file->checkpoint->magic = RESUME_MAGIC;
+		file->checkpoint->file_size = size;
+		file->checkpoint->file_digest = digest;
+
+		// Whatever is in the output file belongs to another file
+		ftruncate(file->fd, 0);
+	}
+
+	ftruncate(file->fd, size);
+
+	file->bits = malloc(words * sizeof(unsigned int));
+	memcpy(file->bits, file->checkpoint->bits, words * sizeof(unsigned int));
+	file->size = size;
+	file->digest = digest;
+	file->received = file->checkpoint->received;
+	file->start_time = current_time_in_microseconds();
+	file->last_checkpoint = file->start_time;
+	file->transferred = 0;
+	file->done = 0;
+
+	if (file->received)
+		fprintf(stderr, "FILE: resuming, %ld of %ld chunks are already received\n", file->received, (size + 7) / 8);
+
+	if (file->received == (size + 7) / 8)
+		finish_incoming(file);
+
+	return;
+}
+
+
+void write_file_chunk(struct File_Transfer *file, struct UDP_Datagram *chunk)
+{
+
+	int length;
+	long offset = file_chunk_offset(file, chunk, &length);
+	long index = offset / 8;
+
+	if (file->fd < 0 || offset < 0)
+		return;
+
+	if (length <= 0 || (file->bits[index / 32] & (1U << (index % 32))))
+		return;
+
+	if (pwrite(file->fd, chunk->payload, length, offset) != length)
+	{
+		fprintf(stderr, "Can't write the chunk at offset %ld\n", offset);
+		return;
+	}
+
+	file->bits[index / 32] |= 1U << (index % 32);
+	file->received++;
+	file->transferred += length;
+
+	if (file->received == (file->size + 7) / 8)
+		finish_incoming(file);
+
+	else if (current_time_in_microseconds() - file->last_checkpoint >= RESUME_CHECKPOINT)
+		checkpoint_incoming(file);
+
+	return;
+}
+
+
+int deliver_file_chunk(struct File_Transfer *file, struct UDP_Datagram *chunk)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- In-order delivery of a file chunk. It only matters for the standard output, files have been written when the chunks arrived.
+
+	Returns:
+	--------
+
+	- Number of bytes of the chunk that go to the standard output.
+
+	*/
+
+	if (file->fd >= 0)
+		return 0;
+
+	int length;
+	long offset = file_chunk_offset(file, chunk, &length);
+
+	if (offset < 0)
+		return 0;
+
+	// A new file starts
+	if (offset == 0)
+	{
+		file->delivered_digest = FNV_OFFSET_BASIS;
+		file->start_time = current_time_in_microseconds();
+		file->transferred = 0;
+	}
+
+	file->delivered_digest = fnv1a(file->delivered_digest, chunk->payload, length);
+	file->offset = offset + length;
+	file->transferred += length;
+
+	if (file->offset == file->size)
+		report_file_transfer(file, file->delivered_digest == file->digest ? "OK" : "MISMATCH");
+
+	return length;
+}
+
+
+int message_complete(struct File_Transfer *file, long message)
+{
+
+	long length = file->size - message * MAXLINE < MAXLINE ? file->size - message * MAXLINE : MAXLINE;
+	int chunks = (length + 7) / 8;
+	unsigned int mask = chunks == 32 ? 0xFFFFFFFFU : (1U << chunks) - 1;
+
+	return (file->bits[message] & mask) == mask;
+}
+
+
+void announce_file(struct Transport *transport, struct sockaddr_in *address, struct File_Transfer *file)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends a RESUME_REQUEST for the range after `range_end`. It is the only packet that tells the receiver the size and digest of
+	the file, so it is sent again, without waiting for its reply, when a restarted receiver opens a new session.
+
+	*/
+
+	struct UDP_Datagram request;
+
+	memset(&request, 0, sizeof(request));
+	request.type = RESUME_REQUEST;
+	request.file_offset = file->range_end;
+	request.control.resume.file_size = file->size;
+	request.control.resume.file_digest = file->digest;
+	request.control.resume.session = file->session;
+	request.checksum = calculate_checksum(&request);
+
+	transport_send(transport, &request, datagram_size(&request), address, 0);
+
+	return;
+}
+
+
+void send_resume_request(struct Transport *transport, struct sockaddr_in *address, struct File_Transfer *file)
+{
+
+	announce_file(transport, address, file);
+
+	file->query_offset = file->range_end;
+	file->query_pending = 1;
+	file->query_time = current_time_in_microseconds();
+
+	return;
+}
+
+
+void send_resume_reply(struct Transport *transport, struct sockaddr_in *address, struct File_Transfer *file, struct UDP_Datagram *request,
+					   int delivered_message_no)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Answers with the first range of messages after `request->file_offset` that has a missing chunk. An empty range at the end of
+	the file means that nothing is missing. Without an output file, everything after the offset is asked for. The reply also
+	carries the last delivered message, so that a restarted sender continues after it.
+
+	- The request is the only packet that tells the size and digest of the file, so the file is opened here for the chunks that
+	follow it.
+
+	*/
+
+	struct UDP_Datagram reply;
+	long size = request->control.resume.file_size;
+	unsigned long digest = request->control.resume.file_digest;
+	long start = request->file_offset < 0 ? 0 : request->file_offset, end = size;
+
+	if (file->fd < 0 && size > 0)
+	{
+		file->size = size;
+		file->digest = digest;
+	}
+
+	if (file->fd >= 0 && size > 0)
+	{
+		prepare_incoming(file, size, digest);
+
+		long messages = (size + MAXLINE - 1) / MAXLINE;
+		long first = start / MAXLINE, last;
+
+		while (first < messages && message_complete(file, first))
+			first++;
+
+		for (last = first; last < messages && !message_complete(file, last); last++)
+			;
+
+		start = first * MAXLINE < size ? first * MAXLINE : size;
+		end = last * MAXLINE < size ? last * MAXLINE : size;
+	}
+
+	memset(&reply, 0, sizeof(reply));
+	reply.type = RESUME_REPLY;
+	reply.msgNo = delivered_message_no;
+	reply.file_offset = start;
+	reply.control.resume.resume_end = end;
+	reply.control.resume.file_size = size;
+	reply.control.resume.file_digest = digest;
+	reply.checksum = calculate_checksum(&reply);
+
+	transport_send(transport, &reply, datagram_size(&reply), address, 0);
+
+	return;
+}
+
+
+void apply_resume_reply(struct File_Transfer *file, struct UDP_Datagram *reply, int *message_no)
+{
+
+	// Replies to older requests, or about another file, are ignored.
+	if (!file->query_pending || reply->control.resume.file_size != file->size || reply->control.resume.file_digest != file->digest ||
+		reply->file_offset < file->query_offset)
+		return;
+
+	file->query_pending = 0;
+
+	// Message numbers at or below the last delivered one would be taken as duplicates.
+	if (reply->msgNo > *message_no)
+		*message_no = reply->msgNo;
+
+	file->offset = reply->file_offset < file->size ? reply->file_offset : file->size;
+	file->range_end = reply->control.resume.resume_end > file->offset ? reply->control.resume.resume_end : file->offset;
+
+	if (file->range_end > file->size)
+		file->range_end = file->size;
+
+	return;
+}
+
+
+
+// -------------------------------------------------Forward Error Correction------------------------------------------------------//
+
+/*
+	
+	- Every lost chunk costs at least one timeout and a retransmit. With FEC, after every `fec_group` chunks the sender emits parity
+	packets, and the receiver rebuilds up to that many missing chunks of the group in `ack_cache` without asking for them.
+
+	- Parity row j of a group of chunks d_0, ..., d_(n-1) is:
+
+						p_j = c(j, 0) * d_0 + c(j, 1) * d_1 + ... + c(j, n-1) * d_(n-1)
+
+	where + is XOR and * is multiplication in GF(2^8). c is a Cauchy matrix whose columns are scaled so that row 0 is all ones, so
+	p_0 is the plain XOR of the chunks (`--fec xor`) and more rows give Reed-Solomon (`--fec rs`). Every square sub-matrix of a Cauchy
+	matrix is invertible, so any e parity rows can rebuild any e missing chunks.
+
+*/
+
+unsigned char gf_exp[512];
+unsigned char gf_log[256];
+
+
+void initialize_galois_field()
+{
+
+	int x = 1;
+
+	for (int i = 0; i < 255; i++)
+	{
+		gf_exp[i] = x;
+		gf_log[x] = i;
+
+		x <<= 1;
+
+		if (x & 0x100)
+			x ^= 0x11d;
+	}
+
+	for (int i = 255; i < 512; i++)
+		gf_exp[i] = gf_exp[i - 255];
+
+	return;
+}
+
+
+unsigned char gf_multiply(unsigned char a, unsigned char b)
+{
+
+	if (a == 0 || b == 0)
+		return 0;
+
+	return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+
+unsigned char gf_inverse(unsigned char a)
+{
+	return gf_exp[255 - gf_log[a]];
+}
+
+
+void gf_multiply_region(unsigned char *destination, const unsigned char *source, unsigned char c, int len)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- destination += c * source, byte by byte. With SSSE3, every byte is split into two nibbles and both are looked up with PSHUFB from
+	16 entry tables of c * nibble, 16 (or 8) bytes at a time. The rest is done with log/exp tables.
+
+	*/
+
+	int i = 0;
+
+	if (c == 0)
+		return;
+
+#ifdef __SSSE3__
+	unsigned char low_table[16], high_table[16];
+
+	for (int x = 0; x < 16; x++)
+	{
+		low_table[x] = gf_multiply(c, x);
+		high_table[x] = gf_multiply(c, x << 4);
+	}
+
+	__m128i low = _mm_loadu_si128((const __m128i *) low_table);
+	__m128i high = _mm_loadu_si128((const __m128i *) high_table);
+	__m128i mask = _mm_set1_epi8(0x0f);
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i *) (source + i));
+		__m128i product = _mm_xor_si128(_mm_shuffle_epi8(low, _mm_and_si128(bytes, mask)),
+										_mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi64(bytes, 4), mask)));
+
+		_mm_storeu_si128((__m128i *) (destination + i), _mm_xor_si128(_mm_loadu_si128((const __m128i *) (destination + i)), product));
+	}
+
+	for (; i + 8 <= len; i += 8)
+	{
+		__m128i bytes = _mm_loadl_epi64((const __m128i *) (source + i));
+		__m128i product = _mm_xor_si128(_mm_shuffle_epi8(low, _mm_and_si128(bytes, mask)),
+										_mm_shuffle_epi8(high, _mm_and_si128(_mm_srli_epi64(bytes, 4), mask)));
+
+		_mm_storel_epi64((__m128i *) (destination + i), _mm_xor_si128(_mm_loadl_epi64((const __m128i *) (destination + i)), product));
+	}
+#endif
+
+	for (; i < len; i++)
+		destination[i] ^= gf_multiply(c, source[i]);
+
+	return;
+}
+
+
+unsigned char fec_coefficient(int row, int column)
+{
+
+	unsigned char cauchy = gf_inverse(row ^ (FEC_MAX_PARITY + column));
+	unsigned char first_row = gf_inverse(FEC_MAX_PARITY + column);
+
+	return gf_multiply(cauchy, gf_inverse(first_row));
+}
+
+
+void send_parity(struct Transport *transport, struct Pacer *pacer, struct UDP_Datagram *group, int count, int parity_count, struct sockaddr_in *address)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends `parity_count` parity packets for the `count` chunks starting at `group`. Parity packets are not kept in the window, they
+	are neither ACKed nor retransmitted.
+
+	*/
+
+	for (int j = 0; j < parity_count; j++)
+	{
+		struct UDP_Datagram parity;
+
+		memset(&parity, 0, sizeof(parity));
+
+		parity.type = PARITY_PACKET;
+		parity.sqNo = group[0].sqNo;
+		parity.remained = group[0].remained;
+		parity.msgNo = group[0].msgNo;
+		parity.file_offset = group[0].file_offset;
+		parity.coalesced = group[0].coalesced;
+		parity.stream = group[0].stream;
+		parity.unordered = group[0].unordered;
+		parity.partial = group[0].partial;
+		parity.fec_count = count;
+		parity.fec_index = j;
+
+		for (int i = 0; i < count; i++)
+			gf_multiply_region((unsigned char *) parity.payload, (const unsigned char *) group[i].payload, fec_coefficient(j, i), 8);
+
+		gettimeofday(&(parity.timeout_time), NULL);
+
+		send_datagram(transport, pacer, &parity, address);
+	}
+
+	return;
+}
+
+
+int fec_recover(struct UDP_Datagram *ack_cache, struct UDP_Datagram *parity, int sequence_space, struct UDP_Datagram *recovered)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Tries to rebuild the missing chunks of one group from the parity packets received for it (`parity` is the FEC_MAX_PARITY long
+	row of the group). A chunk is present if its slot in `ack_cache` still holds it, even if it has already been printed.
+
+	- Missing chunks m_0, ..., m_(e-1) and e received parity rows give e equations. Known chunks are moved to the right hand side and
+	the system is solved with Gauss-Jordan elimination in GF(2^8).
+
+	Returns:
+	--------
+
+	- Number of rebuilt chunks. They are written into `ack_cache` and copied into `recovered` so that they can be ACKed.
+
+	*/
+
+	struct UDP_Datagram *first = NULL;
+
+	for (int j = 0; j < FEC_MAX_PARITY && first == NULL; j++)
+		if (parity[j].type == PARITY_PACKET)
+			first = &parity[j];
+
+	if (first == NULL)
+		return 0;
+
+	int count = first->fec_count;
+	int missing[WINDOW_SIZE], rows[FEC_MAX_PARITY];
+	int missing_count = 0, row_count = 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		struct UDP_Datagram *chunk = &ack_cache[(first->sqNo + i) % sequence_space];
+
+		if (chunk->msgNo != first->msgNo || chunk->remained != first->remained - i)
+			missing[missing_count++] = i;
+	}
+
+	for (int j = 0; j < FEC_MAX_PARITY; j++)
+		if (parity[j].type == PARITY_PACKET && parity[j].msgNo == first->msgNo && parity[j].fec_count == count)
+			rows[row_count++] = j;
+
+	if (missing_count == 0)
+		memset(parity, 0, FEC_MAX_PARITY * sizeof(*parity));
+
+	if (missing_count == 0 || row_count < missing_count)
+		return 0;
+
+	// Build the e x e system: matrix[r] * missing chunks = right_side[r]
+	unsigned char matrix[FEC_MAX_PARITY][FEC_MAX_PARITY];
+	unsigned char right_side[FEC_MAX_PARITY][8];
+
+	for (int r = 0; r < missing_count; r++)
+	{
+		int j = rows[r];
+		int next_missing = 0;
+
+		memcpy(right_side[r], parity[j].payload, 8);
+
+		for (int i = 0; i < count; i++)
+		{
+			if (next_missing < missing_count && missing[next_missing] == i)
+			{
+				matrix[r][next_missing++] = fec_coefficient(j, i);
+				continue;
+			}
+
+			struct UDP_Datagram *chunk = &ack_cache[(first->sqNo + i) % sequence_space];
+			gf_multiply_region(right_side[r], (const unsigned char *) chunk->payload, fec_coefficient(j, i), 8);
+		}
+	}
+
+	for (int column = 0; column < missing_count; column++)
+	{
+		int pivot = column;
+
+		while (matrix[pivot][column] == 0)
+			pivot++;
+
+		if (pivot != column)
+		{
+			unsigned char temp_row[FEC_MAX_PARITY], temp_side[8];
+
+			memcpy(temp_row, matrix[pivot], sizeof(temp_row));
+			memcpy(matrix[pivot], matrix[column], sizeof(temp_row));
+			memcpy(matrix[column], temp_row, sizeof(temp_row));
+			memcpy(temp_side, right_side[pivot], 8);
+			memcpy(right_side[pivot], right_side[column], 8);
+			memcpy(right_side[column], temp_side, 8);
+		}
+
+		unsigned char scale = gf_inverse(matrix[column][column]);
+		unsigned char scaled_row[FEC_MAX_PARITY], scaled_side[8];
+
+		memset(scaled_row, 0, sizeof(scaled_row));
+		memset(scaled_side, 0, sizeof(scaled_side));
+		gf_multiply_region(scaled_row, matrix[column], scale, missing_count);
+		gf_multiply_region(scaled_side, right_side[column], scale, 8);
+		memcpy(matrix[column], scaled_row, sizeof(scaled_row));
+		memcpy(right_side[column], scaled_side, 8);
+
+		for (int r = 0; r < missing_count; r++)
+		{
+			if (r == column || matrix[r][column] == 0)
+				continue;
+
+			unsigned char factor = matrix[r][column];
+
+			gf_multiply_region(matrix[r], matrix[column], factor, missing_count);
+			gf_multiply_region(right_side[r], right_side[column], factor, 8);
+		}
+	}
+
+	for (int r = 0; r < missing_count; r++)
+	{
+		int slot = (first->sqNo + missing[r]) % sequence_space;
+		struct UDP_Datagram *chunk = &ack_cache[slot];
+
+		memset(chunk, 0, sizeof(*chunk));
+		chunk->type = DATA_PACKET;
+		chunk->sqNo = slot;
+		chunk->remained = first->remained - missing[r];
+		chunk->msgNo = first->msgNo;
+		chunk->file_offset = first->file_offset;
+		chunk->coalesced = first->coalesced;
+		chunk->stream = first->stream;
+		chunk->unordered = first->unordered;
+		chunk->partial = first->partial;
+		chunk->timeout_time = first->timeout_time;
+		memcpy(chunk->payload, right_side[r], 8);
+		chunk->payload[8] = '\0';
+		chunk->checksum = calculate_checksum(chunk);
+
+		recovered[r] = *chunk;
+	}
+
+	memset(parity, 0, FEC_MAX_PARITY * sizeof(*parity));
+
+	return missing_count;
+}
+
+
+int unpack_records(struct UDP_Datagram *chunk, int *record_left, struct iovec *run)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Drops the length bytes from a chunk of a coalesced message. `record_left` is the part of the current line that is still
+	to come, it carries over from one chunk to the next.
+
+	Returns:
+	--------
+
+	- Number of pieces of text put into `run`, at most 4 for an 8 byte chunk.
+
+	*/
+
+	int count = 0;
+	int length = strnlen(chunk->payload, 8);
+
+	for (int i = 0; i < length; )
+	{
+		if (*record_left == 0)
+		{
+			*record_left = (unsigned char) chunk->payload[i++];
+			continue;
+		}
+
+		int piece = *record_left < length - i ? *record_left : length - i;
+
+		run[count].iov_base = chunk->payload + i;
+		run[count].iov_len = piece;
+		count++;
+
+		i += piece;
+		*record_left -= piece;
+	}
+
+	return count;
+}
+
+
+void release_run(struct Ack_State *ack_state, struct iovec *run, int count, int unordered, int complete)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Hands a run of delivered text to the output. Text of an unordered message is kept in `held` until the message is complete.
+
+	*/
+
+	if (!unordered)
+	{
+		write_output(ack_state->output, run, count);
+		return;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		memcpy(ack_state->held + ack_state->held_length, run[i].iov_base, run[i].iov_len);
+		ack_state->held_length += run[i].iov_len;
+	}
+
+	if (complete)
+	{
+		struct iovec message = { ack_state->held, ack_state->held_length };
+
+		write_output(ack_state->output, &message, 1);
+		ack_state->held_length = 0;
+	}
+
+	return;
+}
+
+
+int deliver_chunks(struct UDP_Datagram *ack_cache, int *cache_index, int *delivered_message_no, struct Ack_State *ack_state, int sequence_space,
+				   struct File_Transfer *file)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Prints the chunks that are ready in order, starting from `cache_index`. Chunks of a file go to `file` instead. The chunks are
+	gathered into one run and handed to the output of `ack_state` at once, before `ack_cache` is cleared. The length bytes of a
+	coalesced message are left out. An unordered message is still ACKed chunk by chunk, but printed only when it is complete.
+
+	Returns:
+	--------
+
+	- 1 if the last chunk of the message (remained == 0) has been printed. Then `ack_cache` is cleared for the next message.
+
+	*/
+
+	struct iovec run[4 * 2 * WINDOW_SIZE];
+	int count = 0;
+	int unordered = 0;
+
+	// Chunks that are ready in order: the run of waiting slots from `cache_index`.
+	int ready = __builtin_ctzl(~rotate_slots(ack_state->waiting, *cache_index, sequence_space));
+
+	for (; ready > 0; ready--)
+	{
+		struct UDP_Datagram *chunk = &ack_cache[*cache_index];
+		int length = chunk->stream == STREAM_FILE ? deliver_file_chunk(file, chunk) : (int) strnlen(chunk->payload, 8);
+
+		unordered = chunk->unordered || chunk->partial || ack_state->whole_messages;
+
+		if (ack_state->relay && chunk->stream != STREAM_FILE && ack_state->relay->number_of_chunks < 32)
+		{
+			memcpy(ack_state->relay->chunks[ack_state->relay->number_of_chunks++], chunk->payload, 8);
+			ack_state->relay->coalesced = chunk->coalesced;
+		}
+
+		if (chunk->coalesced)
+			count += unpack_records(chunk, &ack_state->record_left, run + count);
+
+		else if (length > 0)
+		{
+			run[count].iov_base = chunk->payload;
+			run[count].iov_len = length;
+			count++;
+		}
+
+		ack_state->waiting &= ~(1UL << *cache_index);
+		ack_state->delivered_chunks++;
+
+		// Last chunk of the message (remained == 0) has been printed, get ready for the next message.
+		if (ack_cache[*cache_index].remained == 0)
+		{
+			release_run(ack_state, run, count, unordered, 1);
+			*delivered_message_no = ack_cache[*cache_index].msgNo;
+			memset(ack_cache, 0, sequence_space * sizeof(*ack_cache));
+			ack_state->waiting = 0;
+			*cache_index = 0;
+			ack_state->delivered_chunks = 0;
+			ack_state->record_left = 0;
+			return 1;
+		}
+
+		*cache_index = (*cache_index + 1) % sequence_space;
+
+	}
+
+	release_run(ack_state, run, count, unordered, 0);
+
+	return 0;
+}
+
+
+
+// -------------------------------------------------Acknowledgements--------------------------------------------------------------//
+
+
+void note_received_chunk(struct Ack_State *ack_state, struct UDP_Datagram *packet, int immediate)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Records that a chunk has to be acknowledged. The acknowledgement waits for reverse data up to ACK_DELAY unless `immediate`
+	is given or `frequency` chunks are already waiting.
+
+	*/
+
+	if (!ack_state->pending)
+		ack_state->deadline = current_time_in_microseconds() + ACK_DELAY;
+
+	ack_state->pending = 1;
+	ack_state->unacked++;
+	ack_state->echo_time = time_in_microseconds(&packet->timeout_time);
+	ack_state->echo_path = packet->path;
+
+	if (immediate || ack_state->unacked >= ack_state->frequency)
+		ack_state->immediate = 1;
+
+	return;
+}
+
+
+void piggyback_ack(struct UDP_Datagram *packet, int delivered_message_no, struct Ack_State *ack_state, int window_size)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Writes the current acknowledgement (cumulative count + SACK bits of the chunks in `ack_state->waiting`) into an outgoing packet.
+	Stored packets can be updated before they are retransmitted, send_datagram computes the checksum again.
+
+	*/
+
+	int cache_index = ack_state->delivered_chunks % (2 * window_size);
+
+	packet->ack_stream = ack_state->stream;
+	packet->ack_msgNo = delivered_message_no + 1;
+	packet->ack_count = ack_state->delivered_chunks;
+	packet->sack_bits = 0;
+	packet->ack_echo_time = ack_state->echo_time;
+	packet->ack_echo_path = ack_state->echo_path;
+	packet->rwnd = advertised_window(window_size, ack_state);
+
+	if (ack_state->use_sack)
+		packet->sack_bits = rotate_slots(ack_state->waiting, cache_index, 2 * window_size) & ((1UL << window_size) - 1);
+
+	ack_state->pending = 0;
+	ack_state->immediate = 0;
+	ack_state->unacked = 0;
+
+	return;
+}
+
+
+void send_ack(struct Transport *transport, struct sockaddr_in *address, int delivered_message_no, struct Ack_State *ack_state, int window_size)
+{
+
+	struct UDP_Datagram ack;
+
+	memset(&ack, 0, sizeof(ack));
+	ack.type = ACK_PACKET;
+	ack.is_ACKed = 1;
+	piggyback_ack(&ack, delivered_message_no, ack_state, window_size);
+	ack.checksum = calculate_checksum(&ack);
+
+	transport_send(transport, &ack, datagram_size(&ack), address, 0);
+
+	return;
+}
+
+
+int apply_ack(struct Window *window, struct UDP_Datagram *packet, int message_no, int sent)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Marks the chunks of the current message that `packet` acknowledges. Chunks [0, ack_count) are acknowledged cumulatively and
+	ack_count + i for every set bit i of `sack_bits`. An acknowledgement for a later message means the current one is complete.
+
+	Returns:
+	--------
+
+	- Number of chunks that are newly ACKed.
+
+	*/
+
+	if (message_no == 0 || packet->ack_msgNo < message_no)
+		return 0;
+
+	int cumulative = packet->ack_msgNo > message_no ? sent : packet->ack_count;
+
+	// ack_count comes from the peer and is used as a shift count, so it is kept in [0, sent].
+	if (cumulative > sent)
+		cumulative = sent;
+
+	if (cumulative < 0)
+		cumulative = 0;
+
+	// The cumulative part and the SACK bits after it are ORed into the window at once, the new bits are counted.
+	unsigned long acks = (1UL << cumulative) - 1;
+
+	if (packet->ack_msgNo == message_no)
+		acks |= ((unsigned long) (packet->sack_bits & ((1 << window->window_size) - 1)) << cumulative) & ((1UL << sent) - 1);
+
+	acks &= ~window->acked;
+	window->acked |= acks;
+
+	return __builtin_popcountl(acks);
+}
+
+
+
+void slide_window(struct Window *window)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Moves the start of the window over the chunks that are ACKed, see `Receive Operations` block. The run of ACKed chunks from
+	the start is the number of trailing ones of `acked` shifted down to the start, so it is found with one bit scan. Bits above 
+	the message are zero, so the complement always has a set bit.
+
+	*/
+
+	int start = window->pass * 2 * window->window_size + window->sequence_number;
+	int slide = __builtin_ctzl(~(window->acked >> start));
+
+	window->sequence_number += slide;
+	window->buffer_available += slide;
+	window->pass += window->sequence_number / (2 * window->window_size);
+	window->sequence_number %= 2 * window->window_size;
+
+	return;
+}
+
+
+// -------------------------------------------------Streams-----------------------------------------------------------------------//
+void initialize_stream(struct Stream *stream, int id)
+{
+
+	memset(stream, 0, sizeof(*stream));
+
+	stream->id = id;
+	initialize_window(&stream->window, WINDOW_SIZE);
+
+	for (int i = 0; i < 32; i++)
+		stream->own_chunks[i] = stream->chunk_data[i];
+
+	stream->flow.peer_window = WINDOW_SIZE;
+	stream->flow.persist_time_out = TIME_OUT;
+	stream->retransmit_limit = -1;
+
+	stream->ack_state.stream = id;
+	stream->ack_state.frequency = ACK_FREQUENCY;
+	stream->ack_state.use_sack = 1;
+
+	return;
+}
+
+
+void reset_reassembly(struct Stream *stream)
+{
+
+	memset(stream->ack_cache, 0, sizeof(stream->ack_cache));
+	memset(stream->fec_cache, 0, sizeof(stream->fec_cache));
+	stream->cache_index = 0;
+	stream->ack_state.delivered_chunks = 0;
+	stream->ack_state.record_left = 0;
+	stream->ack_state.held_length = 0;
+	stream->ack_state.waiting = 0;
+
+	if (stream->ack_state.relay)
+		stream->ack_state.relay->number_of_chunks = 0;
+
+	return;
+}
+
+
+struct Stream* receiving_stream(struct Stream *streams, int id)
+{
+
+	if (id < 0 || id >= STREAM_COUNT)
+		return NULL;
+
+	return &streams[id];
+}
+
+
+struct Stream* next_sending_stream(struct Stream *streams, int window_size, int *probe_zero_window)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Picks the stream whose next chunk goes out. Streams are tried in order, so typed lines go ahead of the file, and a stream can
+	send when its own window and the peer's window for it have room and fewer than `window_size` chunks are in flight over all streams.
+	If the peer has closed the window of a stream and nothing is in flight to bring a window update, its next chunk is sent anyway
+	as a zero window probe once the persist timer expires.
+
+	Returns:
+	--------
+
+	- The stream, NULL if no chunk can be sent now.
+
+	*/
+
+	int in_flight = 0;
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+		in_flight += streams[i].window.window_size - streams[i].window.buffer_available;
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		struct Stream *stream = &streams[i];
+
+		if (stream->sent_chunks == 0)
+			continue;
+
+		*probe_zero_window = stream->flow.peer_window == 0 && stream->total_send_packets == 0 &&
+							 current_time_in_microseconds() - stream->window.last_activity >= stream->flow.persist_time_out;
+
+		if ((usable_window(&stream->window, &stream->flow) > 0 && in_flight < window_size) || *probe_zero_window)
+			return stream;
+	}
+
+	*probe_zero_window = 0;
+
+	return NULL;
+}
+
+
+void piggyback_stream_ack(struct UDP_Datagram *packet, struct Stream *streams, struct Stream *stream)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- A packet carries the acknowledgement of one stream. A stream with a pending acknowledgement is preferred (an immediate one
+	first), otherwise the one of `stream` is repeated.
+
+	*/
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+		if (streams[i].ack_state.pending && (streams[i].ack_state.immediate || !stream->ack_state.pending))
+			stream = &streams[i];
+
+	piggyback_ack(packet, stream->delivered_message_no, &stream->ack_state, stream->window.window_size);
+
+	return;
+}
+
+
+void send_pending_acks(struct Transport *transport, struct sockaddr_in *address, struct Stream *streams)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- No data went back in time to carry the acknowledgements of `streams`, they are sent on their own.
+
+	*/
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		struct Ack_State *ack_state = &streams[i].ack_state;
+
+		if (ack_state->pending && (ack_state->immediate || current_time_in_microseconds() >= ack_state->deadline))
+			send_ack(transport, address, streams[i].delivered_message_no, ack_state, streams[i].window.window_size);
+	}
+
+	return;
+}
+
+
+long ack_time_out(struct Stream *streams, long poll_time_out)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Shortens `poll_time_out` (in microseconds) so that poll wakes up when the first pending acknowledgement of `streams` is due.
+
+	*/
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		if (streams[i].ack_state.pending)
+		{
+			long time_out = streams[i].ack_state.deadline - current_time_in_microseconds();
+
+			if (time_out < poll_time_out)
+				poll_time_out = time_out < 0 ? 0 : time_out;
+		}
+	}
+
+	return poll_time_out;
+}
+
+
+long stream_time_out(struct Stream *stream, struct RTT_Estimator *rtt, long poll_time_out)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Shortens `poll_time_out` (in microseconds) to the next retransmission, probe, expiry or skip timer of `stream`.
+
+	*/
+
+	// An expired message only waits for the next SKIP_PACKET, its chunks are not retransmitted anymore.
+	if (stream->expired)
+	{
+		long skip_time_out = stream->skip_time + TIME_OUT - current_time_in_microseconds();
+
+		return skip_time_out < poll_time_out ? (skip_time_out < 0 ? 0 : skip_time_out) : poll_time_out;
+	}
+
+	if (stream->expire_time && (stream->sent_chunks || stream->total_send_packets))
+	{
+		long expire_time_out = stream->expire_time - current_time_in_microseconds();
+
+		if (expire_time_out < poll_time_out)
+			poll_time_out = expire_time_out < 0 ? 0 : expire_time_out;
+	}
+
+	if (stream->total_send_packets || (stream->sent_chunks && stream->flow.peer_window == 0))
+	{
+		long time_out = next_poll_time_out(&stream->window, rtt, &stream->flow, packet_index(&stream->window, stream->window.sequence_number), 
+										   stream->number_of_chunks - stream->sent_chunks, stream->sent_chunks == 0);
+
+		if (time_out < poll_time_out)
+			poll_time_out = time_out;
+	}
+
+	return poll_time_out;
+}
+
+
+void expire_message(struct Stream *stream)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Gives up the message being sent on `stream`. Chunks that haven't been sent are dropped and the ones in flight are not
+	retransmitted anymore. The receiver is told to skip the message with SKIP_PACKET instead, and its ACK for the next message
+	marks every chunk as ACKed, so the window moves on as if the message had been delivered.
+
+	*/
+
+	stream->number_of_chunks -= stream->sent_chunks;
+	stream->sent_chunks = 0;
+	stream->expired = 1;
+	stream->skip_time = 0;
+
+	return;
+}
+
+
+void send_skip(struct Transport *transport, struct Pacer *pacer, struct Stream *stream, struct sockaddr_in *address)
+{
+
+	struct UDP_Datagram skip;
+
+	memset(&skip, 0, sizeof(skip));
+	skip.type = SKIP_PACKET;
+	skip.stream = stream->id;
+	skip.msgNo = stream->message_no;
+	gettimeofday(&skip.timeout_time, NULL);
+
+	send_datagram(transport, pacer, &skip, address);
+	stream->skip_time = time_in_microseconds(&skip.timeout_time);
+
+	return;
+}
+
+
+void skip_message(struct Stream *stream, int message_no)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Receiver side of an expired message. Its chunks are dropped and it counts as delivered, so that the ACK tells the sender to
+	go on. Nothing of it has been printed, a message that can expire is held until it is complete (see `partial`).
+
+	*/
+
+	reset_reassembly(stream);
+	stream->delivered_message_no = message_no;
+
+	return;
+}
+
+
+// -------------------------------------------------Paths-------------------------------------------------------------------------//
+void add_path(struct Path *paths, int *path_count, struct in_addr local, struct sockaddr_in *peer)
+{
+
+	struct Path *path = &paths[(*path_count)++];
+
+	memset(path, 0, sizeof(*path));
+	path->local = local;
+	path->peer = *peer;
+	path->congestion_window = PATH_INITIAL_WINDOW;
+
+	return;
+}
+
+
+void initialize_paths(struct Path *paths, int *path_count, struct sockaddr_in *peer, struct Options *options)
+{
+
+	struct in_addr any = { INADDR_ANY };
+
+	*path_count = 0;
+	add_path(paths, path_count, any, peer);
+
+	for (int i = 0; i < options->path_count; i++)
+		add_path(paths, path_count, options->path_sources[i], peer);
+
+	return;
+}
+
+
+void learn_path(struct Path *paths, int *path_count, struct sockaddr_in *from)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Called with the source of every received datagram. The first one completes the paths whose peer isn't known yet (the server
+	doesn't know the client before its HELLO), and a new address of the peer becomes a new path.
+
+	*/
+
+	int unknown = 0;
+
+	for (int i = 0; i < *path_count; i++)
+	{
+		if (paths[i].peer.sin_port == from->sin_port && paths[i].peer.sin_addr.s_addr == from->sin_addr.s_addr)
+			return;
+
+		unknown += paths[i].peer.sin_port == 0;
+	}
+
+	struct in_addr any = { INADDR_ANY };
+
+	if (unknown)
+	{
+		for (int i = 0; i < *path_count; i++)
+			if (paths[i].peer.sin_port == 0)
+				paths[i].peer = *from;
+	}
+	else if (*path_count < PATH_COUNT)
+		add_path(paths, path_count, any, from);
+	else
+		return;
+
+	fprintf(stderr, "PATH: %s:%d\n", inet_ntoa(from->sin_addr), ntohs(from->sin_port));
+
+	return;
+}
+
+
+int path_in_flight(struct Stream *streams, int path)
+{
+
+	int in_flight = 0;
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		struct Window *window = &streams[i].window;
+		int end = streams[i].number_of_chunks - streams[i].sent_chunks;
+
+		for (unsigned long missing = unacked_chunks(window, end); missing; missing &= missing - 1)
+			in_flight += window->packets[__builtin_ctzl(missing)].path == path;
+	}
+
+	return in_flight;
+}
+
+
+int schedule_path(struct Path *paths, int path_count, struct Stream *streams)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Picks the path for the next chunk. A chunk sent on a path waits behind the chunks already in flight there, so the expected
+	time is SRTT * (in flight + 1) / congestion window, and SRTT is scaled up by the loss rate of the path. The path with the
+	lowest time among the ones whose congestion window has room wins, a path without an RTT sample yet is tried first. If every
+	congestion window is full, the least loaded path is used.
+
+	Returns:
+	--------
+
+	- Index of the path.
+
+	*/
+
+	int best = -1, least_loaded = 0;
+	double best_time = 0, least_load = 0;
+
+	for (int i = 0; i < path_count; i++)
+	{
+		if (paths[i].peer.sin_port == 0)
+			continue;
+
+		int in_flight = path_in_flight(streams, i);
+		double load = (double) in_flight / paths[i].congestion_window;
+		double time = paths[i].rtt.srtt * (paths[i].sent + 1.0) / (paths[i].sent - paths[i].lost + 1.0) * (in_flight + 1) / paths[i].congestion_window;
+
+		if (i == 0 || load < least_load)
+		{
+			least_loaded = i;
+			least_load = load;
+		}
+
+		if (in_flight < paths[i].congestion_window && (best < 0 || time < best_time))
+		{
+			best = i;
+			best_time = time;
+		}
+	}
+
+	return best >= 0 ? best : least_loaded;
+}
+
+
+void send_on_path(struct Transport *transport, struct Pacer *pacer, struct UDP_Datagram *packet, struct Path *paths, int path,
+				  struct sockaddr_in *address)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends a chunk on `path`. `address` is used while the peer of the path isn't known.
+
+	*/
+
+	packet->path = path;
+
+	if (++paths[path].sent == PATH_LOSS_HISTORY)
+	{
+		paths[path].sent /= 2;
+		paths[path].lost /= 2;
+	}
+
+	select_source(transport, paths[path].local);
+	send_datagram(transport, pacer, packet, paths[path].peer.sin_port ? &paths[path].peer : address);
+
+	return;
+}
+
+
+void path_timed_out(struct Path *paths, int path)
+{
+
+	paths[path].lost++;
+	paths[path].acked = 0;
+
+	if (paths[path].congestion_window > 1)
+		paths[path].congestion_window /= 2;
+
+	return;
+}
+
+
+void path_acked(struct Path *paths, int path_count, int path, int newly_acked, long rtt_sample, int window_size)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Takes the RTT sample and opens the congestion window of the path that the acknowledgement is about.
+
+	*/
+
+	if (path < 0 || path >= path_count)
+		return;
+
+	update_rtt_estimator(&paths[path].rtt, rtt_sample);
+	paths[path].acked += newly_acked;
+
+	if (paths[path].acked >= paths[path].congestion_window)
+	{
+		paths[path].acked = 0;
+
+		if (paths[path].congestion_window < window_size)
+			paths[path].congestion_window++;
+	}
+
+	return;
+}
+
+
+// -------------------------------------------------Session-----------------------------------------------------------------------//
+int offered_features(struct Options *options)
+{
+
+	int features = FEATURES_SUPPORTED;
+
+	if (options->no_sack)
+		features &= ~FEATURE_SACK;
+
+	return features;
+}
+
+
+void send_control_packet(struct Transport *transport, struct sockaddr_in *address, int type)
+{
+
+	struct UDP_Datagram packet;
+
+	memset(&packet, 0, sizeof(packet));
+	packet.type = type;
+	packet.is_ACKed = 1;
+	gettimeofday(&packet.timeout_time, NULL);
+	packet.checksum = calculate_checksum(&packet);
+
+	transport_send(transport, &packet, datagram_size(&packet), address, 0);
+
+	return;
+}
+
+
+void send_hello(struct Transport *transport, struct sockaddr_in *address, struct Session *session, struct Options *options)
+{
+
+	struct UDP_Datagram hello;
+
+	memset(&hello, 0, sizeof(hello));
+	hello.type = HELLO_PACKET;
+	hello.is_ACKed = session->established;
+	hello.rwnd = options->window;
+	hello.control.hello.mss = CHUNK_SIZE;
+	hello.control.hello.checksum_type = CHECKSUM_HEADER;
+	hello.control.hello.ack_frequency = options->ack_frequency;
+	hello.control.hello.features = offered_features(options);
+	gettimeofday(&hello.timeout_time, NULL);
+	hello.checksum = calculate_checksum(&hello);
+
+	transport_send(transport, &hello, datagram_size(&hello), address, 0);
+	session->hello_time = time_in_microseconds(&hello.timeout_time);
+
+	return;
+}
+
+
+int accept_hello(struct Session *session, struct UDP_Datagram *hello, struct Options *options, struct Stream *streams)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Negotiates the session parameters from the HELLO of the peer, the first time it arrives. Features that the peer doesn't offer
+	are turned off in `options` and `streams`, and the windows of the streams (all idle before the handshake) are resized.
+
+	Returns:
+	--------
+
+	- 0 if the peer uses a chunk size or checksum that this side doesn't support, then the session can't be opened.
+
+	*/
+
+	if (hello->control.hello.mss != CHUNK_SIZE || hello->control.hello.checksum_type != CHECKSUM_HEADER)
+	{
+		fprintf(stderr, "%s\n", "Peer uses an unsupported chunk size or checksum, session is closed.");
+		return 0;
+	}
+
+	if (session->established)
+		return 1;
+
+	session->established = 1;
+	session->window_size = hello->rwnd < options->window ? hello->rwnd : options->window;
+	session->features = offered_features(options) & hello->control.hello.features;
+
+	if (session->window_size < 1)
+		session->window_size = 1;
+
+	int frequency = hello->control.hello.ack_frequency < 1 ? 1 : hello->control.hello.ack_frequency;
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		initialize_window(&streams[i].window, session->window_size);
+		streams[i].flow.peer_window = session->window_size;
+		streams[i].ack_state.frequency = frequency < session->window_size ? frequency : session->window_size;
+		streams[i].ack_state.use_sack = (session->features & FEATURE_SACK) != 0;
+		streams[i].unordered = streams[i].unordered && (session->features & FEATURE_UNORDERED);
+	}
+
+	if (!(session->features & FEATURE_FEC))
+		options->fec_parity = 0;
+
+	if (options->fec_group > session->window_size)
+		options->fec_group = session->window_size;
+
+	if (!(session->features & FEATURE_COALESCE))
+		options->coalesce = 0;
+
+	if (!(session->features & FEATURE_SKIP))
+	{
+		options->deadline = 0;
+		options->max_retransmit = -1;
+	}
+
+	fprintf(stderr, "SESSION: window %d, ACK frequency %d, features %x\n", session->window_size, streams[0].ack_state.frequency, session->features);
+
+	return 1;
+}
+
+
+int streams_idle(struct Stream *streams)
+{
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+		if (streams[i].sent_chunks || streams[i].total_send_packets || streams[i].expired)
+			return 0;
+
+	return 1;
+}
+
+
+// -------------------------------------------------Fan-out-----------------------------------------------------------------------//
+struct Member* find_member(struct Group *group, struct sockaddr_in *address)
+{
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+	{
+		struct Member *member = &group->members[i];
+
+		if (member->active && member->address.sin_port == address->sin_port && member->address.sin_addr.s_addr == address->sin_addr.s_addr)
+			return member;
+	}
+
+	return NULL;
+}
+
+
+struct Member* join_member(struct Group *group, struct sockaddr_in *address, struct Stream *streams, struct UDP_Datagram *hello,
+						   struct Session *session)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Adds the sender of `hello` to the group. The session keeps the parameters negotiated with the first member, so the others
+	have to offer at least the same window and features.
+
+	Returns:
+	--------
+
+	- The member, NULL if it is refused or the group is full.
+
+	*/
+
+	struct Member *member = find_member(group, address);
+
+	if (member)
+		return member;
+
+	if (!session->established || hello->control.hello.mss != CHUNK_SIZE || hello->control.hello.checksum_type != CHECKSUM_HEADER ||
+		hello->rwnd < session->window_size || (session->features & ~hello->control.hello.features))
+	{
+		fprintf(stderr, "MEMBER: %s:%d refused, its parameters don't match the group\n", inet_ntoa(address->sin_addr), ntohs(address->sin_port));
+		return NULL;
+	}
+
+	for (int i = 0; i < GROUP_SIZE && member == NULL; i++)
+		if (!group->members[i].active)
+			member = &group->members[i];
+
+	if (member == NULL)
+	{
+		fprintf(stderr, "MEMBER: %s:%d refused, the group is full\n", inet_ntoa(address->sin_addr), ntohs(address->sin_port));
+		return NULL;
+	}
+
+	int frequency = hello->control.hello.ack_frequency < 1 ? 1 : hello->control.hello.ack_frequency;
+
+	memset(member, 0, sizeof(*member));
+	member->active = 1;
+	member->address = *address;
+	member->last_heard = current_time_in_microseconds();
+	member->streams = malloc(STREAM_COUNT * sizeof(struct Stream));
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		struct Ack_State *ack_state = &member->streams[i].ack_state;
+
+		initialize_stream(&member->streams[i], i);
+		initialize_window(&member->streams[i].window, session->window_size);
+		ack_state->output = streams[i].ack_state.output;
+		ack_state->frequency = frequency < session->window_size ? frequency : session->window_size;
+		ack_state->use_sack = streams[i].ack_state.use_sack;
+		ack_state->whole_messages = 1;
+
+		member->join_message[i] = streams[i].message_no + 1;
+		member->peer_window[i] = session->window_size;
+	}
+
+	group->count++;
+	fprintf(stderr, "MEMBER: %s:%d joined\n", inet_ntoa(address->sin_addr), ntohs(address->sin_port));
+
+	return member;
+}
+
+
+void free_member(struct Member *member)
+{
+
+	for (int i = 0; member->streams && i < STREAM_COUNT; i++)
+		release_relay_message(member->streams[i].ack_state.relay);
+
+	for (int i = 0; i < member->queue_count; i++)
+		release_relay_message(member->queue[(member->queue_head + i) % RELAY_QUEUE]);
+
+	release_relay_message(member->sending);
+
+	free(member->streams);
+	free(member->relay);
+	member->streams = NULL;
+	member->relay = NULL;
+	member->sending = NULL;
+	member->queue_count = 0;
+
+	return;
+}
+
+
+void leave_member(struct Group *group, struct Member *member, const char *reason)
+{
+
+	fprintf(stderr, "MEMBER: %s:%d %s\n", inet_ntoa(member->address.sin_addr), ntohs(member->address.sin_port), reason);
+
+	free_member(member);
+	member->active = 0;
+	group->count--;
+
+	return;
+}
+
+
+int takes_part(struct Member *member, struct Stream *stream)
+{
+
+	return member->active && member->join_message[stream->id] <= stream->message_no;
+}
+
+
+unsigned long sent_mask(struct Stream *stream)
+{
+
+	return (1UL << (stream->number_of_chunks - stream->sent_chunks)) - 1;
+}
+
+
+void start_group_message(struct Group *group, struct Stream *stream)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- A new message starts on `stream`, nobody has any of its chunks yet. The silence timer of the members starts over, they
+	had nothing to ACK before.
+
+	*/
+
+	long now = current_time_in_microseconds();
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+	{
+		group->members[i].acked[stream->id] = 0;
+
+		if (group->members[i].last_heard < now)
+			group->members[i].last_heard = now;
+	}
+
+	return;
+}
+
+
+int group_passed(struct Group *group, struct Stream *stream)
+{
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+		if (takes_part(&group->members[i], stream) && !(group->members[i].acked[stream->id] & MESSAGE_PASSED))
+			return 0;
+
+	return 1;
+}
+
+
+int settle_group_acks(struct Group *group, struct Stream *stream)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Marks the chunks of the current message on `stream` that every member taking part has.
+
+	Returns:
+	--------
+
+	- Number of chunks that are newly ACKed.
+
+	*/
+
+	unsigned long common = ~0UL;
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+		if (takes_part(&group->members[i], stream))
+			common &= group->members[i].acked[stream->id];
+
+	common &= sent_mask(stream) & ~stream->window.acked;
+	stream->window.acked |= common;
+
+	return __builtin_popcountl(common);
+}
+
+
+int apply_group_ack(struct Group *group, struct Member *member, struct Stream *stream, struct UDP_Datagram *packet)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Like apply_ack, but the acknowledgement of `member` is added to its own chunks first. The peer window of the stream is the
+	smallest window among the members taking part.
+
+	Returns:
+	--------
+
+	- Number of chunks that are newly ACKed by the whole group.
+
+	*/
+
+	int id = stream->id;
+
+	if (!takes_part(member, stream) || stream->message_no == 0 || packet->ack_msgNo < stream->message_no)
+		return 0;
+
+	int sent = stream->number_of_chunks - stream->sent_chunks;
+	int cumulative = packet->ack_count < sent ? packet->ack_count : sent;
+
+	if (cumulative < 0)
+		cumulative = 0;
+
+	member->peer_window[id] = packet->rwnd;
+
+	if (packet->ack_msgNo > stream->message_no)
+		member->acked[id] = ~0UL;
+	else
+		member->acked[id] |= ((1UL << cumulative) - 1) | (((unsigned long) (unsigned) packet->sack_bits << cumulative) & sent_mask(stream));
+
+	stream->flow.peer_window = stream->window.window_size;
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+		if (takes_part(&group->members[i], stream) && group->members[i].peer_window[id] < stream->flow.peer_window)
+			stream->flow.peer_window = group->members[i].peer_window[id];
+
+	if (stream->flow.peer_window > 0)
+		stream->flow.persist_time_out = TIME_OUT;
+
+	return settle_group_acks(group, stream);
+}
+
+
+void settle_group(struct Group *group, struct Stream *streams)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- After a member leaves, the chunks that only it was missing are ACKed, and the windows move on.
+
+	*/
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		streams[i].total_send_packets -= settle_group_acks(group, &streams[i]);
+		slide_window(&streams[i].window);
+
+		if (streams[i].expired && group_passed(group, &streams[i]))
+			streams[i].expired = 0;
+	}
+
+	return;
+}
+
+
+void replicate_chunk(struct Transport *transport, struct Pacer *pacer, struct Group *group, struct Stream *stream, struct UDP_Datagram *packet, int index)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends the stored chunk `index` of `stream` to every member taking part that doesn't have it yet.
+
+	*/
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+	{
+		struct Member *member = &group->members[i];
+
+		if (takes_part(member, stream) && !(member->acked[stream->id] >> index & 1))
+			send_datagram(transport, pacer, packet, &member->address);
+	}
+
+	return;
+}
+
+
+void send_group_skip(struct Transport *transport, struct Pacer *pacer, struct Group *group, struct Stream *stream)
+{
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+		if (takes_part(&group->members[i], stream) && !(group->members[i].acked[stream->id] & MESSAGE_PASSED))
+			send_skip(transport, pacer, stream, &group->members[i].address);
+
+	stream->skip_time = current_time_in_microseconds();
+
+	return;
+}
+
+
+int drop_silent_members(struct Group *group, struct Stream *streams, long now)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Drops the members that miss chunks of a message in flight and haven't been heard for MEMBER_TIME_OUT.
+
+	Returns:
+	--------
+
+	- Number of members dropped.
+
+	*/
+
+	int dropped = 0;
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+	{
+		struct Member *member = &group->members[i];
+		int missing = 0;
+
+		if (!member->active || now - member->last_heard < MEMBER_TIME_OUT)
+			continue;
+
+		for (int j = 0; j < STREAM_COUNT; j++)
+			if ((streams[j].total_send_packets || streams[j].expired) && takes_part(member, &streams[j]) &&
+				(member->acked[j] & sent_mask(&streams[j])) != sent_mask(&streams[j]))
+				missing = 1;
+
+		if (member->relay && (member->relay->total_send_packets || member->relay->expired))
+			missing = 1;
+
+		if (missing)
+		{
+			leave_member(group, member, "timed out");
+			dropped++;
+		}
+	}
+
+	return dropped;
+}
+
+
+// -------------------------------------------------Relay-------------------------------------------------------------------------//
+
+
+void open_relay(struct Member *member, int window_size)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Makes a relay room member of `member`: the lines of the room go to it on a stream of its own, so its window, losses and
+	receive window only hold up its own lines, and the lines it sends are kept to be passed on.
+
+	*/
+
+	member->relay = malloc(sizeof(struct Stream));
+	initialize_stream(member->relay, STREAM_CHAT);
+	initialize_window(&member->relay->window, window_size);
+	member->relay->flow.peer_window = window_size;
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+		member->streams[i].ack_state.relay = new_relay_message();
+
+	return;
+}
+
+
+void queue_relay_message(struct Group *group, struct Member *member, struct Relay_Message *relay)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Queues `relay` for `member`. A member that is RELAY_QUEUE lines behind is dropped from the room instead, the others don't
+	wait for it and its backlog doesn't grow without bound.
+
+	*/
+
+	if (member->queue_count == RELAY_QUEUE)
+	{
+		leave_member(group, member, "dropped, too far behind");
+		return;
+	}
+
+	member->queue[(member->queue_head + member->queue_count) % RELAY_QUEUE] = relay;
+	member->queue_count++;
+	relay->references++;
+
+	return;
+}
+
+
+void forward_message(struct Group *group, struct Member *source, struct Stream *stream)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- A message of `source` is complete on `stream`. The chunks kept in its reassembly are queued for every other member, and the
+	reassembly keeps the next message in a new one.
+
+	*/
+
+	struct Relay_Message *relay = stream->ack_state.relay;
+
+	if (relay == NULL || relay->number_of_chunks == 0)
+		return;
+
+	stream->ack_state.relay = new_relay_message();
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+		if (group->members[i].relay && &group->members[i] != source)
+			queue_relay_message(group, &group->members[i], relay);
+
+	release_relay_message(relay);
+
+	return;
+}
+
+
+void relay_line(struct Group *group, char *message, int coalesced)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- A typed line goes to every member of the room.
+
+	*/
+
+	struct Relay_Message *relay = new_relay_message();
+
+	partition_message(message, relay->chunks);
+	relay->number_of_chunks = (strlen(message) / 8) + (strlen(message) % 8 != 0);
+	relay->coalesced = coalesced;
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+		if (group->members[i].relay)
+			queue_relay_message(group, &group->members[i], relay);
+
+	release_relay_message(relay);
+
+	return;
+}
+
+
+void load_relay_messages(struct Group *group, int window_size, struct Options *options)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Every member whose previous line is ACKed (or has expired and been skipped) gets the next line from its queue.
+
+	*/
+
+	long now = current_time_in_microseconds();
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+	{
+		struct Member *member = &group->members[i];
+		struct Stream *out = member->relay;
+
+		if (out == NULL || out->sent_chunks || out->total_send_packets || out->expired)
+			continue;
+
+		release_relay_message(member->sending);
+		member->sending = NULL;
+
+		if (member->queue_count == 0)
+			continue;
+
+		member->sending = member->queue[member->queue_head];
+		member->queue_head = (member->queue_head + 1) % RELAY_QUEUE;
+		member->queue_count--;
+
+		initialize_window(&out->window, window_size);
+		out->chunks = member->sending->chunks;
+		out->number_of_chunks = member->sending->number_of_chunks;
+		out->sent_chunks = out->number_of_chunks;
+		out->current_packet_no = 0;
+		out->message_no++;
+		out->coalesced = member->sending->coalesced;
+		out->expire_time = options->deadline ? now + options->deadline * 1000L : 0;
+		out->retransmits = 0;
+		out->retransmit_limit = options->max_retransmit;
+
+		// The member had nothing to ACK before.
+		if (member->last_heard < now)
+			member->last_heard = now;
+	}
+
+	return;
+}
+
+
+struct Member* next_relay_member(struct Group *group, int *probe_zero_window)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Picks the member whose next chunk goes out. The members take turns starting from `turn`, one chunk each, so a fast member
+	isn't held up by a slow one and a member with a long backlog doesn't crowd out the others. A member whose window is full is
+	passed over until its ACKs arrive.
+
+	Returns:
+	--------
+
+	- The member, NULL if no chunk can be sent now.
+
+	*/
+
+	for (int i = 0; i < GROUP_SIZE; i++)
+	{
+		struct Member *member = &group->members[(group->turn + i) % GROUP_SIZE];
+		struct Stream *out = member->relay;
+
+		if (out == NULL || out->sent_chunks == 0)
+			continue;
+
+		*probe_zero_window = out->flow.peer_window == 0 && out->total_send_packets == 0 &&
+							 current_time_in_microseconds() - out->window.last_activity >= out->flow.persist_time_out;
+
+		if (usable_window(&out->window, &out->flow) > 0 || *probe_zero_window)
+			return member;
+	}
+
+	*probe_zero_window = 0;
+
+	return NULL;
+}
+
+
+void send_relay_chunk(struct Transport *transport, struct Pacer *pacer, struct Group *group, struct Member *member, int probe_zero_window)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Sends the next chunk of the line in the window of `member`, with the acknowledgement of what the member has sent. Then the
+	turn passes to the next member.
+
+	*/
+
+	struct Stream *out = member->relay;
+
+	if (probe_zero_window && out->flow.persist_time_out < POLL_TIME_OUT * 1000L)
+		out->flow.persist_time_out *= 2;
+
+	out->sent_chunks--;
+
+	int chunk_index = packet_index(&out->window, out->current_packet_no);
+	struct UDP_Datagram *packet = create_packet(out->chunks[chunk_index], out->current_packet_no);
+
+	packet->remained = out->sent_chunks;
+	packet->msgNo = out->message_no;
+	packet->stream = out->id;
+	packet->coalesced = out->coalesced;
+	packet->partial = out->expire_time != 0 || out->retransmit_limit >= 0;
+	piggyback_stream_ack(packet, member->streams, &member->streams[out->id]);
+
+	send_datagram(transport, pacer, packet, &member->address);
+
+	out->total_send_packets++;
+	store_chunk(&out->window, chunk_index, packet);
+	out->current_packet_no = (out->current_packet_no + 1) % (2 * out->window.window_size);
+	free(packet);
+
+	group->turn = (member - group->members + 1) % GROUP_SIZE;
+
+	return;
+}
+
+
+void relay_timers(struct Transport *transport, struct Pacer *pacer, struct RTT_Estimator *rtt, struct Member *member, long now)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Timeout block of the stream that carries the room to `member`, see `Timeout` block of the main loop: expiry, SKIP_PACKET,
+	retransmission and tail loss probe.
+
+	*/
+
+	struct Stream *out = member->relay;
+
+	if (!out->expired && out->expire_time && (out->sent_chunks || out->total_send_packets) && now >= out->expire_time)
+		expire_message(out);
+
+	if (out->expired)
+	{
+		if (now - out->skip_time >= TIME_OUT)
+			send_skip(transport, pacer, out, &member->address);
+
+		return;
+	}
+
+	if (out->total_send_packets == 0)
+		return;
+
+	int end = out->number_of_chunks - out->sent_chunks;
+
+	for (unsigned long missing = unacked_chunks(&out->window, end); missing; missing &= missing - 1)
+	{
+		int i = __builtin_ctzl(missing);
+		struct UDP_Datagram *chunk = &out->window.packets[i];
+
+		if (!timer_expired(&out->window, i, now))
+			continue;
+
+		if (out->retransmit_limit >= 0 && out->retransmits >= out->retransmit_limit)
+		{
+			expire_message(out);
+			return;
+		}
+
+		out->retransmits++;
+		arm_timer(&out->window, i);
+		piggyback_stream_ack(chunk, member->streams, &member->streams[out->id]);
+		send_datagram(transport, pacer, chunk, &member->address);
+		out->window.last_activity = now;
+	}
+
+	if (out->sent_chunks == 0 && !out->window.probe_sent && now - out->window.last_activity >= probe_time_out(rtt))
+	{
+		unsigned long missing = unacked_chunks(&out->window, end);
+		int highest = missing ? 63 - __builtin_clzl(missing) : -1;
+
+		if (highest >= 0)
+		{
+			arm_timer(&out->window, highest);
+			piggyback_stream_ack(&out->window.packets[highest], member->streams, &member->streams[out->id]);
+			send_datagram(transport, pacer, &out->window.packets[highest], &member->address);
+		}
+
+		out->window.probe_sent = 1;
+		out->window.last_activity = now;
+	}
+
+	return;
+}
+
+
+int relay_idle(struct Group *group)
+{
+	/*
+	Function Description:
+	---------------------
+
+	- Tells whether every line of the room has been delivered to every member (always, outside of a relay room).
+
+	*/
+
+	for (int i = 0; group && i < GROUP_SIZE; i++)
+	{
+		struct Stream *out = group->members[i].relay;
+
+		if (out && (group->members[i].queue_count || out->sent_chunks || out->total_send_packets || out->expired))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+void reliable_data_transfer(int sockfd, struct sockaddr_in* client_address, char* message, int* len, struct Options *options)
+{
+
+	/*
+	
+	Function Definition:
+	--------------------
+
+	- This function implements the reliable data transfer protocol using UDP Datagrams and Selective Repeat Protocol.
+	- ....
+	- .... 
+
+	Steps:
+		1) Given a message, read it in chunks, make these chunks a packet.
+
+
+	*/
+
+	// Typed lines and the file are sent on streams of their own, so that neither one is blocked behind the other.
+	struct Stream streams[STREAM_COUNT];
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+		initialize_stream(&streams[i], i);
+
+	struct Stream *file_stream = &streams[STREAM_FILE];
+
+	// Chunks rebuilt from the parity packets of a group.
+	struct UDP_Datagram recovered[2 * WINDOW_SIZE];
+	int recovered_count = 0;
+	initialize_galois_field();
+
+	struct Output output;
+	initialize_output(&output);
+
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		streams[i].ack_state.output = &output;
+		streams[i].unordered = options->unordered && i != STREAM_FILE;
+	}
+
+	// Polling Declarations
+	int num_events;
+	struct Transport transport;
+	initialize_transport(&transport, sockfd, options);
+
+	struct Input input;
+	initialize_input(&input, STDIN_FILENO);
+
+	struct Io_Thread *io_thread = NULL;
+
+	// The daemon serves its applications from the I/O thread.
+	if (options->use_io_thread || options->daemon_path)
+	{
+		io_thread = malloc(sizeof(struct Io_Thread));
+		io_thread->path = options->daemon_path;
+		io_thread->listen_fd = options->daemon_path ? open_daemon_socket(options->daemon_path) : -1;
+
+		if (options->daemon_path && io_thread->listen_fd < 0)
+		{
+			fprintf(stderr, "Can't listen on %s\n", options->daemon_path);
+			exit(-1);
+		}
+
+		// Opened for writing too, so that a FIFO doesn't end when its last writer closes it.
+		io_thread->urgent_fd = options->urgent_input && !options->daemon_path ? open(options->urgent_input, O_RDWR) : -1;
+
+		if (options->urgent_input && !options->daemon_path && io_thread->urgent_fd < 0)
+		{
+			fprintf(stderr, "Can't open %s\n", options->urgent_input);
+			exit(-1);
+		}
+
+		if (start_io_thread(io_thread, &input, &output, options->daemon_path ? run_daemon_thread : run_io_thread) == 0)
+			transport.input_fd = io_thread->input_event;
+		else if (options->daemon_path)
+		{
+			fprintf(stderr, "%s\n", "Daemon thread couldn't be started!");
+			exit(-1);
+		}
+		else
+		{
+			fprintf(stderr, "%s\n", "I/O thread couldn't be started, stdin and stdout are handled by the main loop.");
+			free(io_thread);
+			io_thread = NULL;
+		}
+	}
+
+	int start, end;
+
+	struct RTT_Estimator rtt;
+	memset(&rtt, 0, sizeof(rtt));
+
+	struct Pacer pacer;
+	initialize_pacer(&pacer, sockfd, options);
+	tune_socket_buffers(&transport, socket_buffer_size(&streams[STREAM_CHAT].window, options));
+
+	struct File_Transfer outgoing, incoming;
+	open_file_transfer(&outgoing, &incoming, options);
+
+	// Nothing is sent before the handshake, and "BYE" closes the session with FIN.
+	struct Session session;
+	memset(&session, 0, sizeof(session));
+
+	// Chunks are striped over the paths to the peer (see struct Path).
+	struct Path paths[PATH_COUNT];
+	int path_count;
+	initialize_paths(paths, &path_count, client_address, options);
+
+	// With `--fan-out`, typed lines go to every member of the group (see struct Member).
+	struct Group *group = NULL;
+
+	if (options->fan_out)
+	{
+		group = malloc(sizeof(struct Group));
+		memset(group, 0, sizeof(*group));
+	}
+
+	while(1)
+	{
+
+		// The output pipe is read again for the first window advertised in this iteration.
+		output.pipe_sampled = 0;
+
+		/*
+			
+			# Definition of `if (sent_chunks)` block:
+			----------------------------------------
+
+			- If there are still packets (chunks) that need to be sent, they have the priority, send them first before taking a new input if exists.
+		
+		    
+		    # Parameters:
+		    -------------
+		    - Every stream keeps its own message, window and counters below (see struct Stream). The next chunk is taken from the first
+		 stream that can send, so typed lines go ahead of the file.
+
+		    - sent_chunks: It is a count parameter showing the remained number of chunks. Let's say total 4 packets
+		 need to be sent. If 3 of them have already been sent, sent_chunks will be equal to 4 - 3 = 1.
+
+		 	- sending_packet: Since packets needs to be sent to client, we need to encapsulate the message under UDP packet. The way, it is done
+		 is calling `create_packet` utility function and passing its return packet as `sending_packet`.
+
+		 	- current_packet_no: It is a circular sequence number for packets that has been created. 
+		 		-> In this implementation, window size is 8. Then, packet numbers follow 0, 1, 2, 3, 4, 5, 6, 7, ..., 14, 15, 0, 1, 2 ... ordering.
+			
+			- input = Lines that have been typed while delivering the current message wait in its ring.
+				-> For example, Suppose we deliver the packages for message "I'm sleeping 4 hours for previous 3 days JUST BECAUSE OF NETWORK HOMEWORK!"
+			and meanwhile the user candy_girl2003 types "What a nice day!", this lovely message needs to be appended to queue on the purpose of 
+			delivering it after the current message delivered.
+
+
+			
+			# Side-Notes:
+			-------------
+
+			- Calculation of current chunk value: window object has 2 important members. These are `pass` and `window_size`. The calculation I used is
+		as the following formula:
+
+							current packet payload = chunks[current payload index] where
+							current payload index = [window.pass * 2 * window.window_size + current_packet_no]
+
+			Suppose that packets have been sent and we have following configuration:
+			(-) denotes that ACK hasn't been recieved at the moment we took below snapshot.
+			(+) denotes that ACK has    been recieved.
+
+
+				14       15           0             1           2             3            4          5          6            7           8
+				-----------------------------------------------------------------------------------------------------------------------------------
+				|   +    |      +     |      +      |      -     |     -      |      -     |     -    |    -     |      -     |    -      |   ....
+				------------------------------------------------------------------------------------------------------------------------------------
+											        ^																				      ^
+										      window sequence                                                                        current packet
+											     number                                                                                 number
+				
+				# If we didn't apply the circular indexing, we would have window sequence number 17. But now it is 8 and we need to send
+			the 24th chunk. Let's look at the formula again to see it gives the correct answer:
+							
+							window pass = 1 since window slided only 1 pass of the length 16 (2 * window size).
+							current payload index = (1 * 2 * 8 + 8 = 24 (Correct) 
+
+		*/
+
+		// The window of a stream is kept until every chunk of its message is ACKed, otherwise lost tail chunks could never be recovered.
+		// Typed lines go to STREAM_CHAT, or to any free unordered stream.
+		int lines_held = 0;
+		int ready = session.established && session.peer_established;
+
+		// In a relay room, typed lines are queued for every member like the lines of the members.
+		while (options->relay && ready && !session.closing && take_message(&input, message, options))
+		{
+			if (!input.coalesced && strcmp(message, "BYE\n") == 0)
+				session.closing = 1;
+			else
+				relay_line(group, message, input.coalesced);
+		}
+
+		if (options->relay)
+		{
+			lines_held = input.batch_time != 0;
+			load_relay_messages(group, session.window_size, options);
+		}
+
+		for (int i = 0; i < STREAM_COUNT && ready && !session.closing && !options->relay; i++)
+		{
+			struct Stream *lane = &streams[i];
+
+			if ((i != STREAM_CHAT && !lane->unordered) || lane->sent_chunks || lane->total_send_packets || lane->expired)
+				continue;
+
+			initialize_window(&lane->window, session.window_size);
+			lane->number_of_chunks = 0;
+			
+			if (take_message(&input, message, options))
+			{
+				// "BYE" is not sent, it closes the session once the lines before it are ACKed.
+				if (!input.coalesced && strcmp(message, "BYE\n") == 0)
+				{
+					session.closing = 1;
+					break;
+				}
+
+				// `chunks` is a string array containing the chunks in the message, partition_message divides the message into at most 8 bytes of chunks.
+				lane->chunks = partition_message(message, lane->own_chunks);
+				
+				// Calculate the total number of chunks
+				lane->number_of_chunks = ((strlen(message)) / 8) + ((strlen(message)) % 8 != 0);
+				lane->sent_chunks = lane->number_of_chunks;
+				lane->current_packet_no = 0;
+				lane->message_no++;
+				lane->coalesced = input.coalesced;
+				lane->expire_time = options->deadline ? current_time_in_microseconds() + options->deadline * 1000L : 0;
+				lane->retransmits = 0;
+				lane->retransmit_limit = options->max_retransmit;
+
+				if (group)
+					start_group_message(group, lane);
+				
+			}
+
+			// Nothing to send, or a batch of lines is being held.
+			else
+			{
+				lines_held = input.batch_time != 0;
+				break;
+			}
+
+		}
+
+		// The file is sent one message at a time on its own stream.
+		if (ready && file_stream->sent_chunks == 0 && file_stream->total_send_packets == 0 && !outgoing.query_pending)
+		{
+
+			initialize_window(&file_stream->window, session.window_size);
+			file_stream->number_of_chunks = 0;
+
+			if (outgoing.offset < outgoing.range_end)
+			{
+				file_stream->number_of_chunks = next_file_message(&outgoing);
+				file_stream->chunks = outgoing.chunks;
+				file_stream->sent_chunks = file_stream->number_of_chunks;
+				file_stream->current_packet_no = 0;
+				file_stream->message_no++;
+			}
+
+			// Every chunk of the file has been ACKed
+			else if (outgoing.fd >= 0 && outgoing.offset == outgoing.size && !outgoing.done)
+			{
+				report_file_transfer(&outgoing, "sent");
+				outgoing.done = 1;
+			}
+
+		}
+
+
+		// The range of the file that the receiver asked for has been sent and ACKed, ask for the next missing one.
+		if (ready && outgoing.fd >= 0 && outgoing.offset == outgoing.range_end && outgoing.range_end < outgoing.size && 
+			file_stream->sent_chunks == 0 && file_stream->total_send_packets == 0 &&
+			(!outgoing.query_pending || current_time_in_microseconds() - outgoing.query_time >= probe_time_out(&rtt)))
+			send_resume_request(&transport, client_address, &outgoing);
+
+
+		// FIN goes out when everything sent before "BYE" has been ACKed, file included.
+		if (session.closing && streams_idle(streams) && relay_idle(group) && current_time_in_microseconds() - session.fin_time >= TIME_OUT)
+		{
+			if (session.fin_retries == FIN_RETRIES || (group && group->count == 0))
+				break;
+
+			if (!group)
+				send_control_packet(&transport, client_address, FIN_PACKET);
+
+			for (int i = 0; group && i < GROUP_SIZE; i++)
+				if (group->members[i].active)
+					send_control_packet(&transport, &group->members[i].address, FIN_PACKET);
+
+			session.fin_time = current_time_in_microseconds();
+			session.fin_retries++;
+		}
+
+
+		int probe_zero_window;
+		struct Stream *stream = next_sending_stream(streams, session.window_size, &probe_zero_window);
+
+		if (stream && pacer_delay(&pacer, DATAGRAM_HEADER_SIZE) == 0)
+		{
+
+			if (probe_zero_window && stream->flow.persist_time_out < POLL_TIME_OUT * 1000L)
+				stream->flow.persist_time_out *= 2;
+
+			stream->sent_chunks--;
+
+			// -------------------------------------------Create the Packet--------------------------------------------//
+				
+				struct UDP_Datagram *sending_packet;
+				
+				sending_packet = create_packet(stream->chunks[packet_index(&stream->window, stream->current_packet_no)], stream->current_packet_no);
+				sending_packet->remained = stream->sent_chunks;
+				sending_packet->msgNo = stream->message_no;
+				sending_packet->stream = stream->id;
+
+				if (stream->chunks == outgoing.chunks)
+					stamp_file_chunk(&outgoing, sending_packet);
+				else
+					sending_packet->coalesced = stream->coalesced;
+
+				sending_packet->unordered = stream->unordered;
+				sending_packet->partial = stream->expire_time != 0 || stream->retransmit_limit >= 0;
+
+				// Copies of a chunk go to every member, so they can't carry the acknowledgement of one of them.
+				if (!group)
+					piggyback_stream_ack(sending_packet, streams, stream);
+
+				
+
+				//--------------------------------------Send the Packet--------------------------------------------//
+				
+				int path = 0;
+
+				if (group)
+					replicate_chunk(&transport, &pacer, group, stream, sending_packet, packet_index(&stream->window, stream->current_packet_no));
+				else
+				{
+					path = schedule_path(paths, path_count, streams);
+					send_on_path(&transport, &pacer, sending_packet, paths, path, client_address);
+				}
+
+				stream->total_send_packets++;
+				
+				
+				int chunk_index = packet_index(&stream->window, stream->current_packet_no);
+
+				store_chunk(&stream->window, chunk_index, sending_packet);
+				stream->current_packet_no = (stream->current_packet_no + 1) % (2 * stream->window.window_size);
+				free(sending_packet);
+
+				// Group of chunks is complete (or the message has ended), send its parity packets.
+				if (options->fec_parity && ((chunk_index + 1) % options->fec_group == 0 || stream->sent_chunks == 0))
+				{
+					int group_start = chunk_index - chunk_index % options->fec_group;
+
+					send_parity(&transport, &pacer, &stream->window.packets[group_start], chunk_index - group_start + 1, options->fec_parity,
+								paths[path].peer.sin_port ? &paths[path].peer : client_address);
+				}
+
+		}
+
+		
+
+		// In a relay room every member has a window of its own, and the members take turns.
+		struct Member *receiver = options->relay ? next_relay_member(group, &probe_zero_window) : NULL;
+
+		if (receiver && pacer_delay(&pacer, DATAGRAM_HEADER_SIZE) == 0)
+			send_relay_chunk(&transport, &pacer, group, receiver, probe_zero_window);
+
+		// No data went back in time to carry the acknowledgement, send it on its own.
+		send_pending_acks(&transport, client_address, streams);
+
+		for (int i = 0; group && i < GROUP_SIZE; i++)
+			if (group->members[i].active)
+				send_pending_acks(&transport, &group->members[i].address, group->members[i].streams);
+
+		// Sleep until the next retransmission or probe timer of any stream. If there are chunks that fit into the window, sleep only
+		// until the pacer allows the next one. Timeout is in microseconds, so ppoll is used instead of poll.
+		long poll_time_out = POLL_TIME_OUT * 1000L;
+
+		for (int i = 0; i < STREAM_COUNT; i++)
+			poll_time_out = stream_time_out(&streams[i], &rtt, poll_time_out);
+
+		for (int i = 0; group && i < GROUP_SIZE; i++)
+			if (group->members[i].relay)
+				poll_time_out = stream_time_out(group->members[i].relay, &rtt, poll_time_out);
+
+		if (next_sending_stream(streams, session.window_size, &probe_zero_window) || (options->relay && next_relay_member(group, &probe_zero_window)))
+		{
+			long pacing_time_out = (pacer_delay(&pacer, DATAGRAM_HEADER_SIZE) + 999) / 1000;
+
+			if (pacing_time_out < poll_time_out)
+				poll_time_out = pacing_time_out;
+		}
+
+		if (outgoing.query_pending)
+		{
+			long query_time_out = outgoing.query_time + probe_time_out(&rtt) - current_time_in_microseconds();
+
+			if (query_time_out < poll_time_out)
+				poll_time_out = query_time_out < 0 ? 0 : query_time_out;
+		}
+
+		// HELLO is retransmitted until the peer has it, and FIN until the peer answers.
+		if (!session.peer_established && client_address->sin_port)
+		{
+			long hello_time_out = session.hello_time + TIME_OUT - current_time_in_microseconds();
+
+			if (hello_time_out < poll_time_out)
+				poll_time_out = hello_time_out < 0 ? 0 : hello_time_out;
+		}
+
+		if (session.closing && streams_idle(streams) && relay_idle(group))
+		{
+			long fin_time_out = session.fin_time + TIME_OUT - current_time_in_microseconds();
+
+			if (fin_time_out < poll_time_out)
+				poll_time_out = fin_time_out < 0 ? 0 : fin_time_out;
+		}
+
+		// A partial batch of lines is held for at most the coalescing delay.
+		if (lines_held)
+		{
+			long hold_time_out = input.batch_time + options->coalesce_delay - current_time_in_microseconds();
+
+			if (hold_time_out < poll_time_out)
+				poll_time_out = hold_time_out < 0 ? 0 : hold_time_out;
+		}
+
+		poll_time_out = ack_time_out(streams, poll_time_out);
+
+		for (int i = 0; group && i < GROUP_SIZE; i++)
+			if (group->members[i].active)
+				poll_time_out = ack_time_out(group->members[i].streams, poll_time_out);
+
+		// Collected output is written before sleeping. If the pipe is full, wake up again soon to retry.
+		if (poll_time_out > 0)
+			flush_output(&output);
+
+		if (output.length && poll_time_out > OUTPUT_RETRY)
+			poll_time_out = OUTPUT_RETRY;
+
+		int socket_check_point, stdin_check_point;
+
+		// The ring of typed lines is full, leave the rest in the pipe until a message is ACKed.
+		pause_stdin(&transport, input.count == INPUT_RING || input.closed);
+
+		num_events = transport_wait(&transport, poll_time_out, &socket_check_point, &stdin_check_point);
+
+
+		// ---------------------------------------------Send Operations ---------------------------------------------------------//
+		
+		/*
+
+			Description of `Send Operations` block:
+			---------------------------------------
+			
+			- This block refers to the operations corresponding to sending messages from server to client.
+			- Standard input is read in large blocks without blocking and split into lines, which are queued in the ring of `input`.
+			The message is created from the first line of the ring once the previous one is ACKed (see the block at the top of the loop).
+				
+				-> Why wait for the ACKs? Because the window is kept until every chunk of the message is ACKed, a new message can't
+			reuse it earlier.
+
+				-> When the ring is full, stdin is not read anymore. A fast writer then blocks on the full pipe instead of overflowing
+			the queue, and reading goes on when a line is taken from the ring.
+
+
+		*/
+		read_input(&input, stdin_check_point);
+
+
+		// ------------------------------------------Recieve Operations-----------------------------------------------------------//
+
+		/*
+
+			Description of `Receive Operations` block:
+			------------------------------------------
+
+			- This part of the code corresponds to all of the recieving operations of the chat application.
+			- There are some control points, Let me describe them:
+				(i)   First, checksun is controlled, if there is any corruption in the recieved data, message is asked to be resended.
+				
+				(ii)  Secondly, if message is recieved correctly then server send a ACK message to client.
+
+				(iii) Furthermore, every recieved UDP packet may carry an acknowledgement (ack_msgNo != 0). Then chunks it acknowledges are
+			marked and Window sliding operation takes place.
+
+			
+			Side Notes:
+			-----------
+			- How window is slided? Let's take a look at it more closely. Suppose at the snapshot we have following configuration:
+
+					13      14        15        0       1           2           3           4           5              6 
+			--------------------------------------------------------------------------------------------------------------------
+				+	|	+	|	 +    |   	+	|	+	|	  -		|	 +		|	 +		|	  -		|		-	   |
+			--------------------------------------------------------------------------------------------------------------------
+														^
+												 window sequence
+			     									 number		
+		
+			# When an ACK: 1 has been recieved, since window sequence number is pointing to point 1, it will slide whenever it encounters with
+		a packet with has no ACK or recieved packets are finished, it stops sliding. After ACK 1 is recieved and sliding the window, 
+		the configuration will be like:
+
+					13      14        15        0       1           2           3           4           5              6 
+			--------------------------------------------------------------------------------------------------------------------
+				+	|	+	|	 +    |   	+	|	+	|	  +		|	 +		|	 +		|	  -		|		-	   |
+			--------------------------------------------------------------------------------------------------------------------
+																							^
+												 									  window sequence
+			     									 									  number		
+		
+
+
+		*/
+		if(socket_check_point)
+		{
+			int n;
+			struct UDP_Datagram *receiving_packet;
+
+			receiving_packet = (struct UDP_Datagram*) malloc(sizeof(struct UDP_Datagram));
+
+			n = transport_receive(&transport, receiving_packet, sizeof(*receiving_packet), client_address);
+
+			// The length has to match the type, see datagram_size.
+			if (n < (int) DATAGRAM_HEADER_SIZE || n != (int) datagram_size(receiving_packet))
+			{
+				free(receiving_packet);
+				continue;
+			}
+
+			memset((char *) receiving_packet + n, 0, sizeof(*receiving_packet) - n);
+
+			// Members of a group are not paths.
+			if (!group)
+				learn_path(paths, &path_count, client_address);
+			
+
+			
+			// Check if data is garbled
+			int received_sqNo, recieved_checksum, packet_checksum;
+
+			received_sqNo = receiving_packet->sqNo;
+
+			recieved_checksum = receiving_packet->checksum;
+			packet_checksum = calculate_checksum(receiving_packet);
+
+			// Stream the chunk belongs to, and the one its acknowledgement is about. Every member of a group has its own reassembly.
+			struct Member *member = group ? find_member(group, client_address) : NULL;
+
+			stream = receiving_stream(member ? member->streams : streams, receiving_packet->stream);
+			struct Stream *acked = receiving_stream(streams, receiving_packet->ack_stream);
+
+			// In a relay room, the acknowledgements of a member are about the lines of the room sent to it.
+			if (member && member->relay)
+				acked = receiving_packet->ack_stream == STREAM_CHAT ? member->relay : NULL;
+
+
+			// ---------------------------------------Handshake--------------------------------------------//
+			if (recieved_checksum == packet_checksum && receiving_packet->type == HELLO_PACKET)
+			{
+				if (!accept_hello(&session, receiving_packet, options, streams) && !group)
+				{
+					free(receiving_packet);
+					break;
+				}
+
+				if (group && !(member = join_member(group, client_address, streams, receiving_packet, &session)))
+				{
+					free(receiving_packet);
+					continue;
+				}
+
+				if (options->relay && !member->relay)
+					open_relay(member, session.window_size);
+
+				// Members only answer, the group never starts a handshake.
+				if (group)
+					session.peer_established = 1;
+
+				if (!receiving_packet->is_ACKed)
+				{
+					send_hello(&transport, client_address, &session, options);
+
+					// A receiver that has restarted doesn't know the file that is being sent any more.
+					if (!group && outgoing.fd >= 0 && outgoing.range_end > 0 && !outgoing.done)
+						announce_file(&transport, client_address, &outgoing);
+				}
+				else
+				{
+					session.peer_established = 1;
+					send_control_packet(&transport, client_address, ACK_PACKET);
+				}
+
+				free(receiving_packet);
+				continue;
+			}
+
+			// Chunks are only understood with the negotiated parameters. Anything else the peer sends means that it has our HELLO.
+			if (!session.established)
+			{
+				free(receiving_packet);
+				continue;
+			}
+
+			if (recieved_checksum == packet_checksum)
+				session.peer_established = 1;
+
+			if (group && !member)
+			{
+				free(receiving_packet);
+				continue;
+			}
+
+			if (member)
+				member->last_heard = current_time_in_microseconds();
+
+
+			// ---------------------------------------Close--------------------------------------------//
+			if (recieved_checksum == packet_checksum && receiving_packet->type == FIN_PACKET)
+			{
+				send_control_packet(&transport, client_address, FIN_ACK_PACKET);
+				free(receiving_packet);
+
+				// A member leaving doesn't close the session for the others.
+				if (!group)
+					break;
+
+				leave_member(group, member, "left");
+				settle_group(group, streams);
+				continue;
+			}
+
+			if (recieved_checksum == packet_checksum && receiving_packet->type == FIN_ACK_PACKET && session.closing)
+			{
+				free(receiving_packet);
+
+				if (!group)
+					break;
+
+				leave_member(group, member, "left");
+				continue;
+			}
+			
+			
+			// ---------------------------------------Acknowledgement--------------------------------------------//
+			if (recieved_checksum == packet_checksum && receiving_packet->ack_msgNo && acked)
+			{
+				// Acknowledgement of a chunk that the whole group shares.
+				int shared = member && !member->relay;
+
+				if (!shared && receiving_packet->ack_msgNo >= acked->message_no)
+				{
+					if (receiving_packet->rwnd > 0)
+						acked->flow.persist_time_out = TIME_OUT;
+
+					acked->flow.peer_window = receiving_packet->rwnd;
+				}
+
+				int newly_acked = shared ? apply_group_ack(group, member, acked, receiving_packet) :
+										   apply_ack(&acked->window, receiving_packet, acked->message_no, acked->number_of_chunks - acked->sent_chunks);
+
+				// The peer (or every member) has skipped the expired message.
+				if (acked->expired && (shared ? group_passed(group, acked) : receiving_packet->ack_msgNo > acked->message_no))
+					acked->expired = 0;
+
+				// Old acknowledgements, or the ones about chunks that are already ACKed, don't change anything.
+				if (newly_acked)
+				{
+					long now = current_time_in_microseconds();
+
+					acked->total_send_packets -= newly_acked;
+					update_rtt_estimator(&rtt, now - receiving_packet->ack_echo_time);
+					path_acked(paths, path_count, receiving_packet->ack_echo_path, newly_acked, now - receiving_packet->ack_echo_time, session.window_size);
+					update_pacing_rate(&pacer, &rtt, acked->window.window_size);
+					tune_socket_buffers(&transport, socket_buffer_size(&acked->window, options));
+					acked->window.last_activity = now;
+					acked->window.probe_sent = 0;
+
+					// ------------------Sliding Window Operation ------------------------------------------//
+					
+					slide_window(&acked->window);
+				}
+
+			}
+
+
+			// Compare the checksum with the sent checksum;
+			if (recieved_checksum != packet_checksum)
+			{
+				// The packet is dropped, the sender retransmits it after its timeout.
+			}
+
+			
+			// -----------------------------------Parity--------------------------------------//
+			else if (recieved_checksum == packet_checksum && receiving_packet->type == PARITY_PACKET && stream)
+			{
+
+				if (receiving_packet->msgNo > stream->delivered_message_no && received_sqNo >= 0 && received_sqNo < 2 * stream->window.window_size &&
+					receiving_packet->fec_index >= 0 && receiving_packet->fec_index < FEC_MAX_PARITY &&
+					receiving_packet->fec_count > 0 && receiving_packet->fec_count <= stream->window.window_size &&
+					(stream->id != STREAM_FILE || incoming.size > 0))
+				{
+					stream->fec_cache[received_sqNo][receiving_packet->fec_index] = *receiving_packet;
+
+					recovered_count = fec_recover(stream->ack_cache, stream->fec_cache[received_sqNo], 2 * stream->window.window_size, recovered);
+
+					for (int i = 0; i < recovered_count; i++)
+						stream->ack_state.waiting |= 1UL << recovered[i].sqNo;
+
+					if (deliver_chunks(stream->ack_cache, &stream->cache_index, &stream->delivered_message_no, &stream->ack_state, 2 * stream->window.window_size, &incoming))
+					{
+						memset(stream->fec_cache, 0, sizeof(stream->fec_cache));
+
+						if (member && member->relay)
+							forward_message(group, member, stream);
+					}
+
+					// Rebuilt chunks are ACKed right away as if they were received, so that the sender doesn't retransmit them.
+					for (int i = 0; i < recovered_count; i++)
+					{
+						write_file_chunk(&incoming, &recovered[i]);
+						note_received_chunk(&stream->ack_state, &recovered[i], 1);
+					}
+				}
+
+			}
+
+			
+			// -----------------------------------Resume--------------------------------------//
+			else if (recieved_checksum == packet_checksum && receiving_packet->type == RESUME_REQUEST)
+			{
+				// The sender asks only when everything it sent is ACKed. If it has restarted, chunks of its unfinished message are stale.
+				if (receiving_packet->control.resume.session != incoming.session)
+				{
+					incoming.session = receiving_packet->control.resume.session;
+					reset_reassembly(file_stream);
+				}
+
+				send_resume_reply(&transport, client_address, &incoming, receiving_packet, file_stream->delivered_message_no);
+			}
+
+			else if (recieved_checksum == packet_checksum && receiving_packet->type == RESUME_REPLY)
+				apply_resume_reply(&outgoing, receiving_packet, &file_stream->message_no);
+
+			
+			// -----------------------------------Skip--------------------------------------//
+			else if (recieved_checksum == packet_checksum && receiving_packet->type == SKIP_PACKET && stream)
+			{
+				if (receiving_packet->msgNo > stream->delivered_message_no)
+					skip_message(stream, receiving_packet->msgNo);
+
+				note_received_chunk(&stream->ack_state, receiving_packet, 1);
+			}
+
+			
+			// -----------------------------------Send ACK--------------------------------------//
+			// A sequence number outside the sequence space would index past ack_cache and the waiting bitmap, so the chunk is dropped.
+			// So is a file chunk before the RESUME_REQUEST that tells the size of the file.
+			else if (recieved_checksum == packet_checksum && receiving_packet->type == DATA_PACKET && stream &&
+					 received_sqNo >= 0 && received_sqNo < 2 * stream->window.window_size &&
+					 (stream->id != STREAM_FILE || incoming.size > 0))
+			{
+				// Offset of the chunk from the next chunk expected to be printed, in circular sequence numbers.
+				int cache_offset = (received_sqNo - stream->cache_index + 2 * stream->window.window_size) % (2 * stream->window.window_size);
+				
+				if (receiving_packet->msgNo <= stream->delivered_message_no || cache_offset >= stream->window.window_size)
+				{
+					note_received_chunk(&stream->ack_state, receiving_packet, 1);
+
+					
+				}
+
+				else
+				{
+					stream->ack_cache[received_sqNo] = *receiving_packet;
+					stream->ack_state.waiting |= 1UL << received_sqNo;
+					write_file_chunk(&incoming, receiving_packet);
+
+					// The new chunk may complete a group whose parity has already arrived.
+					recovered_count = 0;
+
+					for (int fec_group = 0; fec_group < 2 * stream->window.window_size; fec_group++)
+						recovered_count += fec_recover(stream->ack_cache, stream->fec_cache[fec_group], 2 * stream->window.window_size, recovered + recovered_count);
+
+					for (int i = 0; i < recovered_count; i++)
+					{
+						stream->ack_state.waiting |= 1UL << recovered[i].sqNo;
+						write_file_chunk(&incoming, &recovered[i]);
+					}
+
+					if (deliver_chunks(stream->ack_cache, &stream->cache_index, &stream->delivered_message_no, &stream->ack_state, 2 * stream->window.window_size, &incoming))
+					{
+						memset(stream->fec_cache, 0, sizeof(stream->fec_cache));
+
+						if (member && member->relay)
+							forward_message(group, member, stream);
+					}
+
+					// A chunk after a gap (or a rebuilt one) is ACKed right away so that the sender learns about the loss quickly.
+					note_received_chunk(&stream->ack_state, receiving_packet, cache_offset > 0 || recovered_count > 0);
+					
+				}
+				
+					
+				
+			}
+
+
+			free(receiving_packet);
+
+		}
+
+
+
+		// -----------------------------------------------------Timeout-------------------------------------------------------//
+
+	/*
+		# Definition of `Timeout` block:
+		--------------------------------
+		- A UDP datagram has timeout_time field.
+		
+		-> UDP DATAGRAM  <-  
+		___________________
+		|		           | 
+		|------------------|     # If a sent packet hasn't been ACKed yet, `timeout_time` value is used to detect this. If this is the case,
+		|	timeout_time   |  send the packet again.
+		|------------------|	 # ACK may be recieved after we resend the packet, in this case take the ACK, if window sequence is 
+		|				   |  pointing to this place, slide the window. When same ACK came twice, do anything.
+		|__________________|
+		
+		- A typed message may expire instead (see `--deadline` and `--max-retransmit`): fresh lines matter more than stale ones, so
+		the window is given to the next message instead of retransmitting this one forever.
+	
+	*/
+		long current_time_microsecond = current_time_in_microseconds();
+		
+		for (int i = 0; i < STREAM_COUNT; i++)
+		{
+			stream = &streams[i];
+
+			if (!stream->expired && stream->expire_time && (stream->sent_chunks || stream->total_send_packets) &&
+				current_time_microsecond >= stream->expire_time)
+				expire_message(stream);
+
+			if (stream->expired)
+			{
+				if (current_time_microsecond - stream->skip_time >= TIME_OUT && group)
+					send_group_skip(&transport, &pacer, group, stream);
+
+				else if (current_time_microsecond - stream->skip_time >= TIME_OUT)
+					send_skip(&transport, &pacer, stream, client_address);
+
+				continue;
+			}
+
+			if (stream->total_send_packets == 0)
+				continue;
+			
+			end = stream->number_of_chunks - stream->sent_chunks;
+			
+			// Only the chunks that are still missing are visited, lowest first.
+			for (unsigned long missing = unacked_chunks(&stream->window, end); missing; missing &= missing - 1)
+			{	
+				start = __builtin_ctzl(missing);
+
+				if (timer_expired(&stream->window, start, current_time_microsecond))
+				{
+					if (stream->retransmit_limit >= 0 && stream->retransmits >= stream->retransmit_limit)
+					{
+						expire_message(stream);
+						break;
+					}
+
+					stream->retransmits++;
+					arm_timer(&stream->window, start);
+
+					// Only the members that miss the chunk get it again.
+					if (group)
+						replicate_chunk(&transport, &pacer, group, stream, &stream->window.packets[start], start);
+					else
+					{
+						piggyback_stream_ack(&stream->window.packets[start], streams, stream);
+
+						// The path it was lost on backs off, and the chunk goes on the best path now.
+						path_timed_out(paths, stream->window.packets[start].path);
+						stream->window.packets[start].path = -1;
+						send_on_path(&transport, &pacer, &stream->window.packets[start], paths, schedule_path(paths, path_count, streams), client_address);
+					}
+
+					stream->window.last_activity = current_time_microsecond;
+
+				}
+
+			}
+
+
+				/*
+					# Tail Loss Probe:
+					------------------
+					- When the last chunks of a message are lost, no later chunk arrives to reveal the gap and only the retransmission
+				timer above could recover them. Instead, if all chunks have been sent and there has been no ACK for 2 * SRTT,
+				the highest unACKed chunk is sent once more so that the receiver ACKs it (or the chunks before it are retransmitted by
+				the timer as usual).
+				*/
+			if (stream->expired)
+				continue;
+
+			if (stream->sent_chunks == 0 && !stream->window.probe_sent && 
+				current_time_microsecond - stream->window.last_activity >= probe_time_out(&rtt))
+			{
+				unsigned long missing = unacked_chunks(&stream->window, end);
+				int highest = missing ? 63 - __builtin_clzl(missing) : -1;
+
+				if (highest >= 0)
+				{
+					arm_timer(&stream->window, highest);
+
+					if (group)
+						replicate_chunk(&transport, &pacer, group, stream, &stream->window.packets[highest], highest);
+					else
+					{
+						piggyback_stream_ack(&stream->window.packets[highest], streams, stream);
+						send_on_path(&transport, &pacer, &stream->window.packets[highest], paths, schedule_path(paths, path_count, streams), client_address);
+					}
+				}
+
+				stream->window.probe_sent = 1;
+				stream->window.last_activity = current_time_microsecond;
+			}
+
+		}
+
+		for (int i = 0; group && i < GROUP_SIZE; i++)
+			if (group->members[i].relay)
+				relay_timers(&transport, &pacer, &rtt, &group->members[i], current_time_microsecond);
+
+		// A member that misses chunks and doesn't answer anymore is dropped, the others don't wait for it.
+		if (group && drop_silent_members(group, streams, current_time_microsecond))
+			settle_group(group, streams);
+
+		// The server learns the address of the client from its first packet, so only the client starts the handshake.
+		if (!session.peer_established && client_address->sin_port && current_time_microsecond - session.hello_time >= TIME_OUT)
+			send_hello(&transport, client_address, &session, options);
+			
+	}
+
+	close_transport(&transport);
+	finish_output(&output);
+
+	if (io_thread)
+	{
+		stop_io_thread(io_thread);
+		free(io_thread);
+	}
+
+	for (int i = 0; group && i < GROUP_SIZE; i++)
+		free_member(&group->members[i]);
+
+	free(group);
+
+	return;
+
+}
@@ -0,0 +1,1187 @@
+#ifndef RDT_H
+#define RDT_H
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/time.h>
+#include <time.h>
+#include <linux/net_tstamp.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <sys/un.h>
+
+
+#define MAXLINE 256
+#define WINDOW_SIZE 8
+#define TIME_OUT 100000
+#define POLL_TIME_OUT 2000
+#define PROBE_TIME_OUT_MIN 10000
+#define PACING_GAIN_PERCENT 125
+#define PACING_BURST 2
+#define PACING_HORIZON 10000000
+#define DATA_PACKET 0
+#define PARITY_PACKET 1
+#define FEC_MAX_PARITY 4
+#define FEC_RS_PARITY 2
+#define FEC_GROUP_SIZE 4
+#define ACK_PACKET 2
+#define ACK_DELAY 10000
+#define ACK_FREQUENCY 4
+#define TRANSPORT_RING_ENTRIES 256
+#define TRANSPORT_POOL_SIZE 64
+#define TRANSPORT_BUFFER_SIZE 2048
+#define TRANSPORT_RECEIVE_SIZE 65536
+#define TRANSPORT_GSO_SEGMENTS 16
+#define TRANSPORT_GSO_BUFFER 4096
+#define TRANSPORT_BUFFER_GROUP 0
+#define TRANSPORT_BATCH 16
+#define TRANSPORT_SEND 1
+#define TRANSPORT_RECEIVE 2
+#define TRANSPORT_STDIN 3
+#define SOCKET_BUFFER_OVERHEAD 1024
+#define SOCKET_BUFFER_HEADROOM 2
+#define FNV_OFFSET_BASIS 14695981039346656037UL
+#define FNV_PRIME 1099511628211UL
+#define RESUME_REQUEST 3
+#define RESUME_REPLY 4
+#define SKIP_PACKET 5
+#define HELLO_PACKET 6
+#define FIN_PACKET 7
+#define FIN_ACK_PACKET 8
+#define FIN_RETRIES 5
+#define CHUNK_SIZE 8
+#define CHECKSUM_HEADER 1
+#define FEATURE_SACK 1
+#define FEATURE_FEC 2
+#define FEATURE_COALESCE 4
+#define FEATURE_UNORDERED 8
+#define FEATURE_SKIP 16
+#define FEATURES_SUPPORTED (FEATURE_SACK | FEATURE_FEC | FEATURE_COALESCE | FEATURE_UNORDERED | FEATURE_SKIP)
+#define RESUME_MAGIC 0x504D544942544452L
+#define RESUME_CHECKPOINT 1000000
+#define OUTPUT_BATCH 4096
+#define OUTPUT_RETRY 1000
+#define INPUT_BLOCK 65536
+#define INPUT_RING 256
+#define DAEMON_APPLICATIONS 16
+#define CACHE_LINE 64
+#define SPSC_SLOTS 256
+#define STREAM_UNORDERED 4
+#define STREAM_COUNT (2 + STREAM_UNORDERED)
+#define STREAM_CHAT 0
+#define STREAM_FILE 1
+#define PATH_COUNT 4
+#define PATH_INITIAL_WINDOW 2
+#define PATH_LOSS_HISTORY 1024
+#define GROUP_SIZE 64
+#define MEMBER_TIME_OUT 5000000
+#define MESSAGE_PASSED (1UL << 63)
+#define RELAY_QUEUE 256
+#define TRANSPORT_CONTROL_SIZE (CMSG_SPACE(sizeof(__u64)) + CMSG_SPACE(sizeof(struct in_pktinfo)))
+#define DATAGRAM_HEADER_SIZE offsetof(struct UDP_Datagram, control)
+
+
+// ------------------------------------------------------Command Line Options----------------------------------------------------//
+
+
+struct Options
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Optional command line arguments given after the address arguments.
+	
+	
+	Members:
+	--------
+	
+	- pacing_rate: `--pacing-rate <bytes/sec>`. Explicit pacing rate, 0 means that it is derived from the window size and SRTT.
+	- use_txtime: `--txtime`. Packets are stamped with their departure time (SO_TXTIME), the main loop still waits for tokens.
+	- txtime_qdisc: `--txtime-qdisc` (implies `--txtime`). The qdisc of the outgoing interface (fq or etf) honours the departure
+	time, so packets are paced by the kernel instead of userspace.
+	- fec_parity: `--fec xor` sends 1 parity packet, `--fec rs` sends FEC_RS_PARITY Reed-Solomon parity packets per group of chunks.
+	`--fec-parity <count>` changes the Reed-Solomon parity count. 0 means no forward error correction.
+	- fec_group: `--fec-group <chunks>`. Number of chunks protected by one set of parity packets, at most WINDOW_SIZE.
+	- use_io_uring: `--io-uring`. Socket and stdin I/O goes through an io_uring ring instead of one syscall per packet.
+	- use_gso: `--gso`. Datagrams sent together are handed to the kernel as one UDP_SEGMENT buffer, and received ones may arrive
+	coalesced by UDP_GRO.
+	- send_file: `--send-file <path>`. File that is sent after the session starts.
+	- receive_file: `--receive-file <path>`. Received files are written here instead of the standard output.
+	- use_io_thread: `--io-thread`. Standard input and output are read and written by a separate thread.
+	- urgent_input: `--urgent-input <path>`, implies `--io-thread`. Lines read from this file (a FIFO, say) are latency critical:
+	they are never held back or packed with other lines, and they go before the lines of stdin that are still waiting. Stdin has no
+	room for such a flag, and with `--daemon` every application flags its own lines, so there it isn't used.
+	- daemon_path: `--daemon <path>`. Applications attach on this Unix domain socket and share the endpoint instead of using stdin
+	and stdout (see struct Application).
+	- coalesce, coalesce_delay: `--coalesce <microseconds>`. Small lines are packed into one message, a partial batch waits at most
+	`coalesce_delay` for more lines. 0 never waits, then only the lines that arrived while a message was in flight are packed.
+	- unordered: `--unordered`. Typed messages are independent, they are spread over STREAM_UNORDERED more streams and each one is
+	printed as soon as it is complete, even if an earlier one is still missing chunks.
+	- deadline: `--deadline <milliseconds>`. A typed message that isn't ACKed within this time after it is taken from the input
+	expires. 0 means no deadline.
+	- max_retransmit: `--max-retransmit <count>`. A typed message expires instead of being retransmitted more than this many times.
+	-1 means no limit. The file never expires. With either option, the receiver prints a message only when it is complete, so an
+	expired message is dropped whole and never shows up as a truncated line.
+	- window: `--window <chunks>`. Window size offered in the handshake, at most WINDOW_SIZE. The smaller offer is used.
+	- ack_frequency: `--ack-frequency <chunks>`. The peer is asked to ACK at least every this many chunks.
+	- no_sack: `--no-sack`. SACK is not offered, only the cumulative acknowledgement is used.
+	- path_sources, path_count: `--path <local address>`, may be given up to PATH_COUNT - 1 times. Chunks are also sent from these
+	addresses, e.g. the addresses of other uplinks (see struct Path).
+	- fan_out: `--fan-out`. Typed lines are sent to every peer that joins with a HELLO, up to GROUP_SIZE of them (see struct
+	Member). Meant for the server.
+	- relay: `--relay`, implies `--fan-out`. A chat room: every line a member sends is passed on to all the other members, and the
+	typed lines go to all of them (see struct Relay_Message).
+	
+	*/
+
+	long pacing_rate;
+	int use_txtime;
+	int txtime_qdisc;
+	int fec_parity;
+	int fec_group;
+	int use_io_uring;
+	int use_gso;
+	char *send_file;
+	char *receive_file;
+	int use_io_thread;
+	char *urgent_input;
+	char *daemon_path;
+	int coalesce;
+	long coalesce_delay;
+	int unordered;
+	long deadline;
+	int max_retransmit;
+	int window;
+	int ack_frequency;
+	int no_sack;
+	struct in_addr path_sources[PATH_COUNT];
+	int path_count;
+	int fan_out;
+	int relay;
+};
+
+
+
+// ---------------------------------------------------------Transport-------------------------------------------------------------//
+
+
+struct Transport_Slot
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Send buffer from the packet pool. The datagram is copied in, because the kernel reads it only when the batch is submitted.
+	With --gso the copy is a whole batch of segments, so a slot is as large as the GSO buffer.
+	
+	*/
+
+	char data[TRANSPORT_GSO_BUFFER];
+	struct sockaddr_in address;
+	struct iovec iov;
+	struct msghdr header;
+	char control[TRANSPORT_CONTROL_SIZE];
+};
+
+
+struct Transport
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Socket and stdin I/O of the main loop. With `--io-uring`, sends are queued as SENDMSG submissions and flushed in batches,
+	datagrams are received by one multishot RECVMSG into buffers provided from the packet pool, stdin is watched by POLL_ADD,
+	and the poll timeout becomes the timeout of io_uring_enter. Otherwise sendmsg/recvmsg and ppoll are used.
+	- With `--gso`, datagrams are collected and sent as one buffer that the kernel segments (UDP_SEGMENT), and buffers that the
+	kernel coalesced on receive (UDP_GRO) are split back into datagrams.
+	
+	
+	Members:
+	--------
+	
+	- sockfd: UDP socket.
+	- use_uring: Whether the io_uring ring could be set up.
+	- poll_fd: ppoll array for the socket and stdin when io_uring is not used.
+	- input_fd: Descriptor watched for input, stdin or the eventfd of the I/O thread.
+	- ring_fd, sq_*, cq_*, sqes, cqes: Submission and completion queues shared with the kernel.
+	- pending_submissions: Submissions written to the queue but not yet given to the kernel.
+	- send_slots, free_slots, free_count: Packet pool for sends, a slot is free again when its completion arrives.
+	- buffer_ring, receive_buffers, buffer_ring_tail: Provided buffer ring that the multishot RECVMSG fills.
+	- receive_header: Tells RECVMSG how much space to leave for the address and control data in each buffer.
+	- ready_buffers, ready_lengths, ready_head, ready_count: Received buffers that haven't been read by the main loop.
+	- receive_armed, stdin_armed: Whether the RECVMSG and POLL_ADD requests are still active.
+	- stdin_ready, stdin_closed: Result of the last stdin poll.
+	- stdin_paused: The sender can't take more input, stdin isn't polled.
+	- use_gso, use_gro: Whether UDP_SEGMENT and UDP_GRO could be enabled on the socket.
+	- gso_buffer, gso_address, gso_count, gso_size: Datagrams collected for the next UDP_SEGMENT send. The buffer holds
+	TRANSPORT_GSO_SEGMENTS datagrams (checked after struct UDP_Datagram), larger ones are flushed earlier.
+	- receive_size, receive_buffer: Size of each receive buffer, and the buffer used without io_uring.
+	- segment_data, segment_left, segment_size, segment_buffer_id, segment_address: Part of the last received buffer that hasn't
+	been returned yet, and the provided buffer it belongs to (-1 without io_uring).
+	- socket_buffer, buffer_capped: Largest SO_SNDBUF/SO_RCVBUF size requested so far, and which of them the kernel capped.
+	- source: Local address that the next datagrams are sent from (IP_PKTINFO), 0 lets the kernel choose. It selects the path.
+	
+	*/
+
+	int sockfd;
+	int use_uring;
+	struct pollfd poll_fd[2];
+	int input_fd;
+
+	int ring_fd;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned pending_submissions;
+
+	struct Transport_Slot *send_slots;
+	int free_slots[TRANSPORT_POOL_SIZE];
+	int free_count;
+
+	struct io_uring_buf_ring *buffer_ring;
+	char *receive_buffers;
+	unsigned short buffer_ring_tail;
+	struct msghdr receive_header;
+
+	int ready_buffers[TRANSPORT_POOL_SIZE];
+	int ready_lengths[TRANSPORT_POOL_SIZE];
+	int ready_head, ready_count;
+
+	int receive_armed, stdin_armed;
+	int stdin_ready, stdin_closed;
+	int stdin_paused;
+
+	int use_gso, use_gro;
+	char gso_buffer[TRANSPORT_GSO_BUFFER];
+	struct sockaddr_in gso_address;
+	int gso_count;
+	size_t gso_size;
+
+	int receive_size;
+	char *receive_buffer;
+	char *segment_data;
+	int segment_left, segment_size, segment_buffer_id;
+	struct sockaddr_in segment_address;
+
+	long socket_buffer;
+	int buffer_capped;
+	struct in_addr source;
+};
+
+
+
+// ---------------------------------------------Single Producer Single Consumer Ring----------------------------------------------//
+
+
+struct Spsc_Slot
+{
+
+	int length;
+	int urgent; // Latency critical line, never held back or packed with other lines (see take_message).
+	char data[MAXLINE];
+};
+
+
+struct Spsc_Ring
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Lock-free ring between two threads, one of them only pushes and the other one only pops. `tail` is written by the producer and
+	`head` by the consumer, each on its own cache line, so the two threads don't keep taking the same line from each other. A thread
+	that has nothing to do sleeps in poll on its eventfd. The producer signals the consumer when it pushes into an empty ring and the
+	consumer signals the producer when it pops from a full one, so a busy ring doesn't cost a syscall per slot.
+	
+	
+	Members:
+	--------
+	
+	- head: Next slot to be popped.
+	- tail: Next slot to be pushed.
+	- consumer_event, producer_event: eventfds of the two sides, -1 if that side never sleeps on the ring.
+	- closed: The producer won't push anymore.
+	- slots: SPSC_SLOTS slots of at most MAXLINE bytes.
+	
+	*/
+
+	unsigned head __attribute__((aligned(CACHE_LINE)));
+	unsigned tail __attribute__((aligned(CACHE_LINE)));
+	int consumer_event __attribute__((aligned(CACHE_LINE)));
+	int producer_event;
+	int closed;
+	struct Spsc_Slot slots[SPSC_SLOTS];
+};
+
+
+
+// -------------------------------------------------Reliable Data Transfer--------------------------------------------------------//
+
+
+
+struct UDP_Datagram	
+{
+	/*
+	
+	Struct Description:
+	-------------------
+
+	- This is the conceptual definition of UDP datagram. When a chunk of message is recieved, UDP protocol will add some additional information
+	to the chunk of message. These aditional informations are given in members.
+
+	
+	Members:
+	--------
+	
+	- type:		DATA_PACKET for chunks of a message, PARITY_PACKET for forward error correction parity of a group of chunks, ACK_PACKET for
+ 	standalone ACKs, RESUME_REQUEST / RESUME_REPLY for the resume handshake of a file, SKIP_PACKET for a message that the sender
+ 	has given up (see expire_message), HELLO_PACKET / FIN_PACKET / FIN_ACK_PACKET to open and close the session (see struct Session).
+	- payload:  8 byte message.
+	- checksum:	Checksum of the whole datagram, see calculate_checksum.
+ 	- sqNo:		Every UDP packet will have a sequence number. Sequence numbers follow a circular manner and 0 based: 0, 1, ..., 2 * WINDOW_SIZE-1, 0, ...
+	- is_ACKed: Specifying that whether this packet is ACKed by the reciever.
+ 	- timeout_time: Every UDP packet has its own sending time. This will be used for detecting whether there exists any timeout for given UDP packet.
+ 	- remained: It is used for detecting if message end has been recieved.
+ 	- rwnd:		Advertised receive window. Receiver puts the number of chunks it can still take into every ACK. For HELLO_PACKET, the
+ 	window size offered.
+ 	- ack_msgNo, ack_count, sack_bits, ack_echo_time: Acknowledgement for the reverse direction. Every packet (data chunks included)
+ 	says that message `ack_msgNo` has been received up to its first `ack_count` chunks, and bit i of `sack_bits` says that chunk
+ 	ack_count + i has been received too. Every earlier message has been received completely. `ack_echo_time` is the send time of the
+ 	chunk that caused the acknowledgement, used for RTT samples. ack_msgNo == 0 means there is no acknowledgement in the packet.
+ 	- fec_count: Only for parity packets, number of chunks in the protected group. The group starts at `sqNo` and `remained`.
+ 	- fec_index: Only for parity packets, which parity row of the group this packet carries.
+ 	- msgNo:	Number of the message this chunk belongs to. Chunks of a message that has already been delivered (e.g. a tail loss probe
+ 	that crossed with the original ACK) are ACKed again but not printed twice. For SKIP_PACKET, the message to skip.
+ 	- file_offset: Only for chunks of a file (stream STREAM_FILE), offset of the message in the file. In the resume handshake, the
+ 	offset the sender asks from and the start of the missing range.
+ 	- coalesced: The message is made of several lines, each one after a 1 byte length (see take_message).
+ 	- stream:	Stream the chunk belongs to, every stream has its own msgNo and sqNo space (see struct Stream).
+ 	- ack_stream: Stream that the acknowledgement fields are about.
+ 	- unordered: The message doesn't have to be printed in order with the other messages. It is printed at once when it is complete.
+ 	- path, ack_echo_path: Path the chunk was sent on (an index of the sender), and the path of the chunk that `ack_echo_time`
+ 	belongs to, so that the RTT sample goes to the right path.
+ 	- partial: The sender may give the message up (see expire_message). The receiver holds it until it is complete.
+ 	- control: Fields of the packet types that open something. Every other packet is sent without them, it ends at
+ 	DATAGRAM_HEADER_SIZE (see datagram_size).
+ 		-> hello: HELLO_PACKET. `mss`, `checksum_type`: the chunk size and checksum the sender uses. `ack_frequency`: how often it
+ 		wants its chunks to be ACKed. `features`: the FEATURE_* flags it offers. `is_ACKed` says that the HELLO of the peer has
+ 		been received.
+ 		-> resume: RESUME_REQUEST / RESUME_REPLY. `file_size`, `file_digest`: size of the file and its digest. The request is
+ 		sent before the first chunk of the file, so the chunks don't carry them. `resume_end`: for the reply, end of the missing
+ 		range. `session`: for the request, start time of the sender, a new value means that the sender has restarted.
+	*/
+
+	int type;
+	char payload[9]; // 8 byte message + '\0'
+	int checksum;
+	int sqNo;
+	int is_ACKed;
+	struct timeval timeout_time;
+	int remained;
+	int rwnd;
+	int ack_msgNo;
+	int ack_count;
+	int sack_bits;
+	long ack_echo_time;
+	int fec_count;
+	int fec_index;
+	int msgNo;
+	long file_offset;
+	int coalesced;
+	int stream;
+	int ack_stream;
+	int unordered;
+	int path;
+	int ack_echo_path;
+	int partial;
+
+	union
+	{
+		struct
+		{
+			int mss;
+			int checksum_type;
+			int ack_frequency;
+			int features;
+		} hello;
+
+		struct
+		{
+			long file_size;
+			unsigned long file_digest;
+			long resume_end;
+			long session;
+		} resume;
+	} control;
+
+};
+
+// A full batch of datagrams has to fit into the GSO buffer of the transport and into an io_uring send slot, and one datagram
+// into a receive buffer.
+_Static_assert(TRANSPORT_GSO_SEGMENTS * sizeof(struct UDP_Datagram) <= TRANSPORT_GSO_BUFFER, "TRANSPORT_GSO_BUFFER is too small");
+_Static_assert(sizeof(((struct Transport_Slot *) 0)->data) >= TRANSPORT_GSO_BUFFER, "Transport_Slot can't hold a GSO batch");
+_Static_assert(sizeof(struct UDP_Datagram) <= TRANSPORT_BUFFER_SIZE, "TRANSPORT_BUFFER_SIZE is too small");
+
+struct Window
+{	
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Selective Repeat uses sliding window operation, we need a 
+	window object.
+	
+	
+	Members:
+	--------
+	
+	- window_size: Negotiated in the handshake, at most WINDOW_SIZE.
+	- sequence_number: It is the starting sequence number of the window. Since we will slide the window it needs to be kept.
+	- buffer_available: number of spots available in the Window buffer.
+	- packets: It is the buffer of the Window. It is declared as 
+	- acked: One bit per entry of `packets`, set when the chunk is ACKed. Sliding and the timeout scan read this word instead of
+	walking the datagrams, see `slide_window`.
+	- deadline: Retransmission deadline of every entry of `packets`, the lower 32 bits of the time in microseconds. Compared
+	with wrap around arithmetic, see `timer_expired`.
+	- last_activity: Time (in microseconds) of the last ACK or transmission. Tail loss probe timer starts from here.
+	- probe_sent: Whether the tail loss probe has already been sent for the current flight.
+	- pass: It specifies how many full pass has occured so far. Let's give an example:
+			
+			# Suppose that window_size = 8.
+			# Also suppose that maximum input line = 256 byte.
+			# Then it will create a UPD_Datagram array of size 256 / 8 = 32. BUT this is not buffer size. This is just for physical design of 
+		buffer. Instead of using a queue structure, I merged all of them. See below for visual explanation:
+
+										________________Window Size_____________
+
+										0       1       2       3              7        0        1            2
+										-----------------------------------------------------------------------	
+										| 		|		| 	    |     .....    |        |        |            |		-> Total 32 byte										  
+										-----------------------------------------------------------------------	
+										^                                      ^
+								   sequence_start	                      sequence_end    
+
+			# Assume that, for the first packet 0, ACK is recieved. Then, window will be slided and will have the form:
+
+												________________Window Size_____________
+
+										0       1       2       3              7        0        1            2
+										-----------------------------------------------------------------------	
+										| 	+	|		| 	    |     .....    |        |        |            |		-> Total 32 byte										  
+										-----------------------------------------------------------------------	
+												^                                       ^
+								   			sequence_start	                        sequence_end  
+							
+	*/				
+	
+	struct UDP_Datagram packets[256 / WINDOW_SIZE];
+	unsigned long acked;
+	unsigned int deadline[256 / WINDOW_SIZE];
+	int window_size; 
+	int sequence_number; // starting sequence number
+	int buffer_available;
+	int pass;
+	int cache_index;
+	long last_activity;
+	int probe_sent;
+};
+
+
+struct RTT_Estimator
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Every ACK echoes the `timeout_time` of the packet it acknowledges, so the time passed since then is one round trip time sample.
+	Samples are smoothed like TCP does (RFC 6298), and the smoothed value is used for the tail loss probe timer.
+	
+	
+	Members:
+	--------
+	
+	- srtt: Smoothed round trip time in microseconds.
+	- rttvar: Round trip time variation in microseconds.
+	- has_sample: Whether at least one sample has been taken.
+	
+	*/
+
+	long srtt;
+	long rttvar;
+	int has_sample;
+};
+
+
+struct Pacer
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Sending a whole window back-to-back creates bursts that overflow switch and receiver socket buffers. Pacer is a token bucket
+	which spaces data packets at `rate`. At most PACING_BURST packets can leave back-to-back.
+	
+	- With kernel pacing (SO_TXTIME), every packet is sent immediately but stamped with its departure time, and the qdisc holds it
+	until then. Otherwise the main loop waits (with a nanosecond ppoll timeout) until the bucket has enough tokens. SO_TXTIME can be
+	enabled even when no fq or etf qdisc is attached, and then the stamp is ignored and packets leave at once. So the kernel is
+	trusted with pacing only when `--txtime-qdisc` says that the qdisc honours it, `--txtime` alone keeps the userspace wait.
+	
+	
+	Members:
+	--------
+	
+	- rate: Pacing rate in bytes per second. 0 means no pacing.
+	- explicit_rate: Rate given from the command line. If it is 0, rate follows the window size and SRTT.
+	- tokens: Bytes that can be sent now. It can become negative when retransmissions are sent without waiting.
+	- last_refill: Last time (CLOCK_MONOTONIC, nanoseconds) tokens were added.
+	- use_txtime: Whether SO_TXTIME could be enabled on the socket.
+	- qdisc_paces: SO_TXTIME is enabled and the qdisc holds packets until their departure time.
+	
+	*/
+
+	long rate;
+	long explicit_rate;
+	double tokens;
+	long last_refill;
+	int use_txtime;
+	int qdisc_paces;
+};
+
+
+struct Flow_Control
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Sender side view of the receiver's advertised window. It outlives the Window object, which is reset for every message.
+	
+	
+	Members:
+	--------
+	
+	- peer_window: Last receive window advertised by the peer. Sender keeps at most min(window_size, peer_window) chunks in flight.
+	- persist_time_out: When peer_window is 0, a chunk is sent as a zero window probe after this many microseconds. It doubles after
+	every probe until the peer opens its window again.
+	
+	*/
+
+	int peer_window;
+	long persist_time_out;
+};
+
+
+struct Output
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Standard output of the receiver. Chunks that are ready in order are handed over as one run instead of one printf per chunk.
+	On a terminal every run goes out right away with a single writev. When the standard output is a pipe or a file, runs are
+	collected and written once OUTPUT_BATCH bytes are waiting or the main loop is about to sleep. A pipe is also made non-blocking,
+	so whatever it can't take stays in the backlog and the main loop retries instead of blocking on a slow reader.
+	
+	
+	Members:
+	--------
+	
+	- backlog, length, capacity: Bytes that haven't been written yet.
+	- batched: Standard output is not a terminal.
+	- ring: With the I/O thread, bytes are pushed into this ring instead of being written.
+	- pipe_size, pipe_queued, pipe_sampled: Capacity of the standard output pipe, read once, and the bytes waiting in it, sampled at
+	most once per iteration of the main loop (see sample_output_pipe). pipe_size is 0 when the standard output is not a pipe.
+	
+	*/
+
+	char *backlog;
+	long length;
+	long capacity;
+	int batched;
+	struct Spsc_Ring *ring;
+	int pipe_size;
+	int pipe_queued;
+	int pipe_sampled;
+};
+
+
+struct Input
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Standard input of the sender. Input is read in blocks of up to INPUT_BLOCK bytes and split into records, one line each. A line
+	longer than MAXLINE - 1 bytes is cut into several records, like fgets did. Records wait in a ring of INPUT_RING entries until the
+	message in flight is ACKed. While the ring is full, stdin isn't polled and the bytes already read stay in the block, so a fast
+	writer is held back by the pipe instead of overflowing the queue.
+	
+	
+	Members:
+	--------
+	
+	- block, start, length: Bytes that have been read but not split into records yet.
+	- records, head, count: Ring of lines waiting to be sent.
+	- drain: Reading never blocks (a pipe made non-blocking, a socket or a file), so stdin is read until it is empty. A terminal is
+	read once per poll.
+	- closed: End of the input has been reached.
+	- fd: Descriptor the lines are read from, stdin or the socket of an application.
+	- ring: With the I/O thread, lines are taken from this ring and stdin isn't read by the main loop.
+	- batch, batch_length, batch_time: Lines packed so far for a coalesced message, and since when the batch has been held.
+	- next, has_next: Line taken from the ring that goes into the next message.
+	- urgent: The last line taken by next_record is latency critical. The flag comes with the line from a ring (see struct
+	Spsc_Slot), the bytes of the line are never looked at for it.
+	- coalesced: The last message taken is packed.
+	
+	*/
+
+	char block[INPUT_BLOCK];
+	int start;
+	int length;
+	char records[INPUT_RING][MAXLINE];
+	int head;
+	int count;
+	int drain;
+	int closed;
+	int fd;
+	struct Spsc_Ring *ring;
+	char batch[MAXLINE];
+	int batch_length;
+	long batch_time;
+	char next[MAXLINE];
+	int has_next;
+	int urgent;
+	int coalesced;
+};
+
+struct Io_Thread
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- With `--io-thread`, standard input and output are handled by a thread of their own. It reads stdin into `reader`, pushes the
+	lines into the `input` ring and writes what the transport pushes into the `output` ring. A slow producer or a stdout reader that
+	blocks the write then only stops this thread, and the main loop keeps processing ACKs and retransmission timers. The main loop
+	polls `input_event` instead of stdin.
+	
+	
+	Members:
+	--------
+	
+	- thread: The I/O thread.
+	- input: Lines read from stdin, from the I/O thread to the transport.
+	- output: Delivered bytes, from the transport to the I/O thread.
+	- reader: Splits stdin into lines like the main loop does without the thread.
+	- urgent_fd, urgent_reader: With `--urgent-input`, the file whose lines are pushed with the urgent flag. -1 otherwise.
+	- input_event: Signaled when a line is pushed into an empty input ring or stdin has ended.
+	- wake_event: Signaled when there is output or the input ring has room again.
+	- stop: The transport is done, the I/O thread exits once the output ring is empty.
+	- listen_fd, path: With `--daemon`, the Unix domain socket the applications attach on, -1 otherwise.
+	
+	*/
+
+	pthread_t thread;
+	struct Spsc_Ring input;
+	struct Spsc_Ring output;
+	struct Input reader;
+	int urgent_fd;
+	struct Input urgent_reader;
+	int input_event;
+	int wake_event;
+	int stop;
+	int listen_fd;
+	const char *path;
+};
+
+
+
+// -------------------------------------------------Daemon------------------------------------------------------------------------//
+
+
+struct Shared_Rings
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Shared memory between the daemon and an application that attaches with `--attach` (a memfd mapped by both). Lines and
+	delivered bytes go through these rings instead of being copied through the socket by the kernel, and the eventfds of the two
+	sides are the doorbells. A ring signals only the other side, so each side fills in the event it signals in its own descriptor
+	numbers: `consumer_event` of `to_daemon` and `producer_event` of `to_application` are set by the application, the other two
+	by the daemon.
+	
+	
+	Members:
+	--------
+	
+	- to_daemon: Lines of the application. `closed` says that its input has ended.
+	- to_application: Bytes delivered by the peer.
+	
+	*/
+
+	struct Spsc_Ring to_daemon;
+	struct Spsc_Ring to_application;
+};
+
+
+struct Application
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- An application attached to the daemon (see `--daemon`). One process owns the UDP socket, the session and its timers, and the
+	applications on the same host share it over a Unix domain socket instead of each one running its own loop. Every line an
+	application writes is sent to the peer, and what the peer sends is delivered to every application. The I/O thread serves the
+	applications, so the main loop is the same as with stdin and stdout. An application whose first byte is '\0' asks for shared
+	rings instead (see struct Shared_Rings), then the socket only tells that it is still there.
+	
+	
+	Members:
+	--------
+	
+	- fd: Daemon's end of the Unix domain socket.
+	- reader: Splits what the application writes into lines, like stdin.
+	- greeted: The first byte has been seen. Nothing is delivered before, the application may still ask for shared rings.
+	- shared, doorbell, peer_doorbell: Shared rings, the eventfd the application rings and the one the daemon rings.
+	
+	*/
+
+	int fd;
+	struct Input reader;
+	int greeted;
+	struct Shared_Rings *shared;
+	int doorbell;
+	int peer_doorbell;
+};
+
+
+struct Relay_Message
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- A line on its way through a relay room (see `--relay`). The chunks of a member's message are kept as they are delivered,
+	payloads as they came, and this one copy is queued for every other member: their windows take `chunks` as they are instead of
+	partitioning the line again. It is freed when the last member is done with it.
+	
+	
+	Members:
+	--------
+	
+	- references: Number of queues, windows and reassemblies that hold the message.
+	- number_of_chunks, coalesced: Chunks kept so far, and whether they are packed lines.
+	- chunk_data, chunks: Payloads of the chunks, and pointers to them in the form the window of a stream takes.
+	
+	*/
+
+	int references;
+	int number_of_chunks;
+	int coalesced;
+	char chunk_data[32][8];
+	char *chunks[32];
+};
+
+
+struct Ack_State
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Receiver side acknowledgement state. Both sides send and receive from the same loop, so instead of answering every chunk with
+	its own datagram, acknowledgements ride on the next data chunk going the other way. A standalone ACK is sent only if no data
+	goes back within ACK_DELAY, or right away when the sender needs it quickly (a gap, a duplicate, or `frequency` chunks waiting).
+	
+	
+	Members:
+	--------
+	
+	- pending: There are received chunks that the peer doesn't know about yet.
+	- immediate: A standalone ACK should go out without waiting for ACK_DELAY.
+	- deadline: Time (in microseconds) the standalone ACK is due.
+	- unacked: Number of chunks received since the last acknowledgement was sent.
+	- echo_time, echo_path: Send time and path of the last received chunk, echoed back for RTT samples.
+	- delivered_chunks: Number of chunks of the current message printed so far, i.e. the cumulative acknowledgement.
+	- output: Standard output, its backlog counts against the advertised window.
+	- record_left: Bytes of the current line that haven't been printed yet, when the message is coalesced.
+	- stream: Stream whose chunks are acknowledged.
+	- held, held_length: Text of an unordered message that has arrived in order so far. It is printed when the message is complete,
+	so that messages of different streams are not mixed in the output.
+	- frequency, use_sack: ACK frequency the peer asked for and whether SACK bits are sent, both negotiated in the handshake.
+	- whole_messages: Every message is printed only when it is complete, like an unordered one. Used when several peers share the
+	output, so that their lines are not mixed.
+	- relay: In a relay room, the chunks of the message are also kept here to be passed on (see struct Relay_Message).
+	- waiting: One bit per slot of `ack_cache` that holds a chunk which hasn't been printed yet. The in order run and the SACK bits
+	are read from this word.
+	
+	*/
+
+	int pending;
+	int immediate;
+	long deadline;
+	int unacked;
+	long echo_time;
+	int echo_path;
+	int delivered_chunks;
+	struct Output *output;
+	int record_left;
+	int stream;
+	char held[32 * 8];
+	int held_length;
+	int frequency;
+	int use_sack;
+	int whole_messages;
+	struct Relay_Message *relay;
+	unsigned long waiting;
+};
+
+
+
+// -------------------------------------------------File Transfer-----------------------------------------------------------------//
+
+
+struct Resume_Bitmap
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Layout of the `<output>.bitmap` file kept next to a received file. Bit i of bits[m] says that chunk i of message m (bytes
+	m * MAXLINE + 8 * i ...) is in the output file. The file is removed when the transfer is verified.
+	
+	*/
+
+	long magic;
+	long file_size;
+	unsigned long file_digest;
+	long received;
+	unsigned int bits[];
+};
+
+
+struct File_Transfer
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- `--send-file` maps the file and cuts it into messages of MAXLINE bytes. Their chunks point straight into the mapping, nothing
+	is copied until the packet is created. `--receive-file` writes every chunk at its offset in the output file as soon as it
+	arrives (pwrite), even out of order. Without `--receive-file`, file chunks are written to the standard output in order.
+
+	- Every file chunk carries the offset of its message, so the receiver can place it even if it was rebuilt from parity. The file
+	size and the FNV-1a digest of the whole file are sent once, in the RESUME_REQUEST that comes before the first chunk. A file
+	chunk that arrives before it (e.g. at a receiver that has restarted) can't be placed, so it is dropped without an ACK, and the
+	sender repeats the request when the new HELLO of the receiver arrives.
+
+	- Before each range of the file, the sender asks the receiver (RESUME_REQUEST) for the first range of messages it is missing
+	after the previous one, and sends only that (RESUME_REPLY). The receiver keeps which chunks it has in a bitmap, and every
+	RESUME_CHECKPOINT microseconds it syncs the output file and copies the bitmap into the memory mapped `<output>.bitmap`. So
+	after either side restarts, only the ranges that weren't checkpointed are sent again.
+	
+	
+	Members:
+	--------
+	
+	- fd: Input or output file, -1 when it is not used.
+	- data: Mapping of the input file.
+	- size, digest: File size and FNV-1a digest of the whole file. Receiver: as told by the last RESUME_REQUEST, 0 before it.
+	- offset: Sender: next byte to be cut into a message. Receiver (standard output): bytes delivered in order.
+	- delivered_digest: Receiver (standard output): digest of the bytes delivered in order.
+	- range_end: Sender: end of the range the receiver asked for.
+	- message_offset: Offset of the message that is being sent.
+	- query_offset, query_pending, query_time: Sender: last RESUME_REQUEST, and whether its reply is still awaited.
+	- session: Sender: its start time. Receiver: session of the last RESUME_REQUEST.
+	- bitmap_path, checkpoint, bitmap_size: Receiver: the mapped bitmap file.
+	- bits, received: Receiver: chunks that are in the output file, they reach `checkpoint` at the next checkpoint.
+	- start_time, last_checkpoint: For the transfer rate and the checkpoint interval.
+	- transferred: Bytes cut into messages (sender) or written (receiver) by this run. After a resume it leaves out the ranges the
+	receiver already had, so the rate is that of the bytes that really crossed the network.
+	- done: The transfer has been reported.
+	- chunks: Chunks of the message that is being sent.
+	
+	*/
+
+	int fd;
+	char *data;
+	long size;
+	unsigned long digest;
+	long offset;
+	unsigned long delivered_digest;
+	long range_end;
+	long message_offset;
+	long query_offset;
+	int query_pending;
+	long query_time;
+	long session;
+	char bitmap_path[MAXLINE];
+	struct Resume_Bitmap *checkpoint;
+	long bitmap_size;
+	unsigned int *bits;
+	long received;
+	long start_time;
+	long last_checkpoint;
+	long transferred;
+	int done;
+	char *chunks[32];
+};
+
+// -------------------------------------------------Streams-----------------------------------------------------------------------//
+
+
+struct Stream
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- One of the independent streams of a session. Every stream has its own messages, window and reassembly, so a message of one
+	stream never waits behind a message of another one: STREAM_CHAT carries the typed lines and STREAM_FILE the file, and a line
+	typed during a transfer doesn't wait for the file message in flight. With `--unordered`, the streams after STREAM_FILE carry
+	typed lines too, so a message whose chunk was lost doesn't hold the next ones back. RTT estimation, pacing and the number of chunks in flight
+	(at most one window over all streams) are shared.
+	
+	
+	Members:
+	--------
+	
+	- id: Index of the stream, sent in its chunks (`stream`) and in acknowledgements about it (`ack_stream`).
+	- window, chunks, number_of_chunks, sent_chunks, current_packet_no, total_send_packets, message_no: Sender side, the message
+	being sent on this stream (see the main loop).
+	- coalesced: The message being sent is made of packed lines.
+	- unordered: Messages of this stream are sent as unordered (see `--unordered`), then they also use the extra streams after
+	STREAM_FILE.
+	- chunk_data, own_chunks: Chunks of a typed message, every stream that sends typed lines needs its own.
+	- expire_time, retransmits, retransmit_limit: Deadline (in microseconds, 0 for none) of the message being sent, how many times
+	its chunks have been retransmitted, and how many times they may be (-1 for no limit).
+	- expired, skip_time: The message has expired and SKIP_PACKET is sent (last at `skip_time`) until the peer ACKs past it.
+	- flow: Receive window that the peer advertises for this stream.
+	- ack_cache, cache_index, delivered_message_no, fec_cache, ack_state: Receiver side, chunks and parity packets of the message
+	being reassembled on this stream, and its acknowledgement.
+	
+	*/
+
+	int id;
+
+	struct Window window;
+	char **chunks;
+	int number_of_chunks;
+	int sent_chunks;
+	int current_packet_no;
+	int total_send_packets;
+	int message_no;
+	int coalesced;
+	int unordered;
+	char chunk_data[32][8];
+	char *own_chunks[32];
+	long expire_time;
+	int retransmits;
+	int retransmit_limit;
+	int expired;
+	long skip_time;
+	struct Flow_Control flow;
+
+	struct UDP_Datagram ack_cache[256 / WINDOW_SIZE];
+	int cache_index;
+	int delivered_message_no;
+	struct UDP_Datagram fec_cache[2 * WINDOW_SIZE][FEC_MAX_PARITY];
+	struct Ack_State ack_state;
+};
+
+
+
+// -------------------------------------------------Paths-------------------------------------------------------------------------//
+
+
+struct Path
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- One way to reach the peer: a local address to send from and the address of the peer. The client has a path for its default
+	address and one for every `--path` address, the server learns a path for every address the client sends from. Every chunk is
+	sent on the path that is expected to deliver it first, and whatever path it arrives on, it goes into the reassembly of its
+	stream. The window shared by all streams still bounds the chunks in flight, the paths only decide where they go.
+	
+	
+	Members:
+	--------
+	
+	- local: Source address, 0 lets the kernel choose.
+	- peer: Address of the peer on this path, port 0 until it is known.
+	- rtt: RTT of the chunks sent on this path.
+	- congestion_window, acked: Congestion window of the path in chunks. It grows by one chunk after a window of ACKs (`acked`
+	counts them), and it is halved when a chunk sent on the path times out.
+	- sent, lost: Chunks sent and timed out on the path. Both are halved after PATH_LOSS_HISTORY chunks, so old losses fade.
+	
+	*/
+
+	struct in_addr local;
+	struct sockaddr_in peer;
+	struct RTT_Estimator rtt;
+	int congestion_window;
+	int acked;
+	int sent;
+	int lost;
+};
+
+
+// -------------------------------------------------Session-----------------------------------------------------------------------//
+
+
+struct Session
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Setup and teardown of the connection. Before any data, both sides send HELLO_PACKET with the parameters they offer, and the
+	session uses the smaller window, the features that both sides offer and the ACK frequency each side asks for. A HELLO that
+	doesn't say that ours has been received is answered with our HELLO, one that says so is answered with a plain ACK_PACKET. Data
+	is sent only when both HELLOs have arrived, so the peer always knows the parameters of the chunks it gets.
+	- Typing "BYE" closes the session. FIN_PACKET is sent once everything sent before it has been ACKed, and the peer answers with
+	FIN_ACK_PACKET and leaves. If the FIN_ACK is lost, the peer is already gone, so FIN is given up after FIN_RETRIES.
+	
+	
+	Members:
+	--------
+	
+	- established: The HELLO of the peer has been received and the parameters below are negotiated.
+	- peer_established: The peer has received our HELLO, data can be sent.
+	- hello_time: Time (in microseconds) our HELLO was last sent. It is retransmitted every TIME_OUT until `peer_established`.
+	- window_size, features: Negotiated window size and FEATURE_* flags.
+	- closing: "BYE" has been typed.
+	- fin_time, fin_retries: Time (in microseconds) FIN was last sent, and how many times it has been sent.
+	
+	*/
+
+	int established;
+	int peer_established;
+	long hello_time;
+	int window_size;
+	int features;
+	int closing;
+	long fin_time;
+	int fin_retries;
+};
+
+
+
+// -------------------------------------------------Fan-out-----------------------------------------------------------------------//
+
+
+struct Member
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- A receiver of the group in `--fan-out` mode. A typed message is segmented and checksummed once and stored once in the window
+	of its stream, then every chunk is copied to each member. Acknowledgements are kept per member, and a chunk counts as ACKed
+	when every member that takes part in the message has it. A chunk that times out is sent again only to the members that miss it.
+	
+	
+	Members:
+	--------
+	
+	- address: Address of the member, it joins with its HELLO.
+	- active: The slot is in use.
+	- acked: Per stream, bit i says that the member has chunk i of the current message, MESSAGE_PASSED that it has ACKed past it.
+	- join_message: Per stream, the first message the member takes part in. A member that joins while a message is in flight
+	starts with the next one, its reassembly can't start in the middle of a message.
+	- peer_window: Per stream, the receive window the member advertises.
+	- last_heard: Time (in microseconds) of the last packet from the member, or of the start of a message. A member that misses
+	chunks and isn't heard for MEMBER_TIME_OUT is dropped, so that it can't hold the others back forever.
+	- streams: Reassembly of the lines that the member sends.
+	- relay, queue, queue_head, queue_count, sending: In a relay room, the stream that carries the lines of the room to the member,
+	the lines waiting for it, and the one in its window (see struct Relay_Message).
+	
+	*/
+
+	struct sockaddr_in address;
+	int active;
+	unsigned long acked[STREAM_COUNT];
+	int join_message[STREAM_COUNT];
+	int peer_window[STREAM_COUNT];
+	long last_heard;
+	struct Stream *streams;
+
+	struct Stream *relay;
+	struct Relay_Message *queue[RELAY_QUEUE];
+	int queue_head;
+	int queue_count;
+	struct Relay_Message *sending;
+};
+
+
+struct Group
+{
+	/*
+	
+	Struct Description:
+	-------------------
+	
+	- Members of the group, `count` of them active. In a relay room, `turn` is the member whose chunk goes out next.
+	
+	*/
+
+	struct Member members[GROUP_SIZE];
+	int count;
+	int turn;
+};
+
+
+// -------------------------------------------------Entry Points------------------------------------------------------------------//
+void parse_options(int argc, char *argv[], int first, struct Options *options);
+void run_attached(const char *path, int urgent);
+void reliable_data_transfer(int sockfd, struct sockaddr_in* client_address, char* message, int* len, struct Options *options);
+
+
+#endif